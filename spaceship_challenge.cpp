@@ -13,201 +13,6572 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <bit>
+#include <bitset>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
 #include <compare>
 #include <concepts>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <future>
+#include <iomanip>
 #include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <random>
 #include <ranges>
+#include <span>
+#include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
 #include <unordered_map>
+#include <utility>
+#include <variant>
 #include <vector>
 
-class Spaceship
+#if defined(__x86_64__)
+#    include <immintrin.h>
+#endif
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#    include <linux/io_uring.h>
+#    include <sys/syscall.h>
+#endif
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Closes a POSIX file descriptor on scope exit
+class FileDescriptor
 {
 public:
-    ~Spaceship() = default;
+    explicit FileDescriptor(const int fd) noexcept : _fd(fd) {}
 
-    // Deleting default constructor
-    Spaceship() = delete;
+    ~FileDescriptor() noexcept
+    {
+        if (_fd >= 0)
+        {
+            ::close(_fd);
+        }
+    }
 
-    // Using constructor instead of static function
-    // Making constructor explicit and noexcept
-    explicit Spaceship(std::vector<std::string>&& part_list) noexcept;
+    FileDescriptor(const FileDescriptor& other) = delete;
+    FileDescriptor& operator=(const FileDescriptor& other) = delete;
 
-    // Spaceship can be copy/move constructed and assigned
-    Spaceship(const Spaceship& other) = default;
-    Spaceship(Spaceship&& other) = default;
-    Spaceship& operator=(const Spaceship& other) = default;
-    Spaceship& operator=(Spaceship&& other) = default;
+    FileDescriptor(FileDescriptor&& other) noexcept
+        : _fd(std::exchange(other._fd, -1))
+    {
+    }
+
+    FileDescriptor& operator=(FileDescriptor&& other) noexcept
+    {
+        std::swap(_fd, other._fd);
+        return *this;
+    }
+
+    [[nodiscard]] int Get() const noexcept { return _fd; }
 
-    // Spaceship for the Spaceship 🙂
-    auto operator<=>(const Spaceship& other) const noexcept = default;
+private:
+    int _fd;
+};
 
-    // Print is a bit prettier
-    void Print() const noexcept
+// read() that retries on EINTR, returns 0 only at end of input
+std::size_t read_some(const int fd, char* const dest, const std::size_t size,
+    const std::filesystem::path& fname)
+{
+    while (true)
     {
-        try
+        const auto count = ::read(fd, dest, size);
+
+        if (count >= 0)
+        {
+            return static_cast<std::size_t>(count);
+        }
+
+        if (errno != EINTR)
         {
-            // This would be a great place for std::format
-            std::cout << "\nThis ship is loaded with:"
-                      << "\n  Engine: " << _parts.at(Part_Type::Engine)
-                      << "\n  Fuselage: " << _parts.at(Part_Type::Fuselage)
-                      << "\n  Cabin: " << _parts.at(Part_Type::Cabin)
-                      << "\n  Armor: " << _parts.at(Part_Type::Armor)
-                      << "\n  Wings:\n    (small): " << _smallWings
-                      << "\n    (large): " << _largeWings;
+            std::stringstream err_mesg;
+            err_mesg << "file: '" << fname.string() << "' could not be read!";
+            throw std::runtime_error(err_mesg.str());
+        }
+    }
+}
 
-            std::cout << "\n  Weapons: [";
+// Opens a catalog file for reading or throws with the usual message
+FileDescriptor open_catalog(const std::filesystem::path& fname)
+{
+    FileDescriptor file(::open(fname.c_str(), O_RDONLY | O_CLOEXEC));
 
-            // Using C++20 ranges
-            for (const auto& weapon : std::views::all(_weapons)
-                    | std::views::take(_weapons.size() - 1))
-            {
-                std::cout << weapon << ", ";
-            }
+    // Early exit
+    if (file.Get() < 0)
+    {
+        const int open_error = errno;
+
+        // Would be nice to have std::format here
+        std::stringstream err_mesg;
+        err_mesg << "file: '" << fname.string()
+                 << (open_error == ENOENT ? "' does not exist!"
+                                          : "' could not be opened!");
+        throw std::runtime_error(err_mesg.str());
+    }
+
+    return file;
+}
+
+// Read-only memory mapping, unmapped on scope exit
+class MappedFile
+{
+public:
+    MappedFile() noexcept = default;
 
-            std::cout << _weapons.back() << "]\n";
+    ~MappedFile() noexcept
+    {
+        if (_data != nullptr)
+        {
+            ::munmap(_data, _size);
         }
-        catch (const std::exception& ex)
+    }
+
+    MappedFile(const MappedFile& other) = delete;
+    MappedFile& operator=(const MappedFile& other) = delete;
+
+    MappedFile(MappedFile&& other) noexcept
+        : _data(std::exchange(other._data, nullptr)),
+          _size(std::exchange(other._size, 0))
+    {
+    }
+
+    MappedFile& operator=(MappedFile&& other) noexcept
+    {
+        std::swap(_data, other._data);
+        std::swap(_size, other._size);
+        return *this;
+    }
+
+    // Maps a whole regular file, empty when it is not one or mmap refuses
+    // (zero-length files included)
+    static MappedFile Map(const int fd) noexcept
+    {
+        struct stat info
         {
-            std::cerr << "Exception: \"" << ex.what() << "\"\n";
+        };
+
+        if (::fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)
+            || info.st_size == 0)
+        {
+            return {};
+        }
+
+        const auto size = static_cast<std::size_t>(info.st_size);
+        void* const data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (data == MAP_FAILED)
+        {
+            return {};
+        }
+
+        return MappedFile(data, size);
+    }
+
+    // Shared read/write mapping of part of a special file, used for the
+    // io_uring rings
+    static MappedFile MapShared(
+        const int fd, const std::size_t size, const off_t offset) noexcept
+    {
+        void* const data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, fd, offset);
+
+        if (data == MAP_FAILED)
+        {
+            return {};
+        }
+
+        return MappedFile(data, size);
+    }
+
+    [[nodiscard]] bool IsMapped() const noexcept { return _data != nullptr; }
+
+    [[nodiscard]] void* Data() const noexcept { return _data; }
+
+    [[nodiscard]] std::string_view Bytes() const noexcept
+    {
+        return { static_cast<const char*>(_data), _size };
+    }
+
+    void Advise(const int advice) const noexcept
+    {
+        if (_data != nullptr)
+        {
+            ::madvise(_data, _size, advice);
         }
     }
 
 private:
-    // Using hashmap for improved performance
-    enum class Part_Type : uint8_t
+    MappedFile(void* const data, const std::size_t size) noexcept
+        : _data(data), _size(size)
     {
-        Engine,
-        Fuselage,
-        Cabin,
-        Wings,
-        Armor,
-        Weapon
-    };
+    }
+
+    void* _data{ nullptr };
+    std::size_t _size{ 0 };
+};
+
+// pread() until 'size' bytes arrived or the file ended, returns the count
+std::size_t pread_fully(const int fd, char* const dest, const std::size_t size,
+    const std::uint64_t offset, const std::filesystem::path& fname)
+{
+    std::size_t done = 0;
+
+    while (done < size)
+    {
+        const auto count = ::pread(fd, dest + done, size - done,
+            static_cast<off_t>(offset + done));
+
+        if (count == 0)
+        {
+            break;
+        }
+
+        if (count < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            std::stringstream err_mesg;
+            err_mesg << "file: '" << fname.string() << "' could not be read!";
+            throw std::runtime_error(err_mesg.str());
+        }
+
+        done += static_cast<std::size_t>(count);
+    }
+
+    return done;
+}
+
+// A regular file being read into its slice of a shared buffer
+struct Pending_File
+{
+    std::filesystem::path name{};
+    FileDescriptor file{ -1 };
+    char* dest{ nullptr };
+    std::size_t size{ 0 };
+};
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+// Just enough io_uring for batched reads, driven through the raw syscalls so
+// there is no liburing dependency
+class ReadRing
+{
+public:
+    ~ReadRing() = default;
+
+    ReadRing() = delete;
+
+    // The ring pointers live inside the owned mappings
+    ReadRing(const ReadRing& other) = delete;
+    ReadRing& operator=(const ReadRing& other) = delete;
+    ReadRing(ReadRing&& other) = default;
+    ReadRing& operator=(ReadRing&& other) = default;
+
+    // Empty when the kernel (or a seccomp filter) refuses io_uring
+    static std::optional<ReadRing> Create(unsigned entries) noexcept;
+
+    [[nodiscard]] unsigned Capacity() const noexcept { return _entries; }
+
+    // Queues a read, the caller keeps at most Capacity() reads in flight
+    void QueueRead(int fd, char* dest, std::uint32_t size,
+        std::uint64_t offset, std::uint64_t user_data) noexcept;
+
+    // Submits everything queued and waits for at least one completion
+    void SubmitAndWait();
+
+    // Calls 'fn(user_data, result)' for every completion ready so far
+    template<typename Fn>
+    void Reap(Fn&& fn);
+
+    // Waits out every read still in flight and drops the results, so the
+    // buffers can be freed while unwinding
+    void Drain() noexcept;
+
+private:
+    explicit ReadRing(FileDescriptor&& ring) noexcept : _ring(std::move(ring))
+    {
+    }
+
+    FileDescriptor _ring;
+    MappedFile _sqRing{};
+    MappedFile _cqRing{};
+    MappedFile _sqeMapping{};
+
+    unsigned _entries{ 0 };
+    unsigned _queued{ 0 };
 
-    std::unordered_map<Part_Type, std::string> _parts{};
+    // Queued or submitted reads whose completion was not reaped yet
+    unsigned _inFlight{ 0 };
 
-    std::string _smallWings{};
-    std::string _largeWings{};
+    unsigned* _sqTail{ nullptr };
+    unsigned* _sqMask{ nullptr };
+    unsigned* _sqArray{ nullptr };
+    io_uring_sqe* _sqes{ nullptr };
 
-    // Utilizing std::array for algorithm support
-    std::array<std::string, 4> _weapons{};
+    unsigned* _cqHead{ nullptr };
+    unsigned* _cqTail{ nullptr };
+    unsigned* _cqMask{ nullptr };
+    io_uring_cqe* _cqes{ nullptr };
 };
 
-Spaceship::Spaceship(std::vector<std::string>&& part_list) noexcept
+std::optional<ReadRing> ReadRing::Create(const unsigned entries) noexcept
 {
-    // Map of types to corresponding strings, would be a great place for 'using enum'
-    const std::unordered_map<Part_Type, const char*> part_types_list{
-        { Part_Type::Engine, "engine" }, { Part_Type::Fuselage, "fuselage" },
-        { Part_Type::Cabin, "cabin" }, { Part_Type::Wings, "wings" },
-        { Part_Type::Armor, "armor" }, { Part_Type::Weapon, "weapon" }
+    io_uring_params params{};
+    ReadRing ring(FileDescriptor(static_cast<int>(
+        ::syscall(__NR_io_uring_setup, entries, &params))));
+
+    if (ring._ring.Get() < 0)
+    {
+        return std::nullopt;
+    }
+
+    const auto fd = ring._ring.Get();
+    const auto sq_size =
+        params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    const auto cq_size =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+    ring._sqRing = MappedFile::MapShared(fd, sq_size, IORING_OFF_SQ_RING);
+    ring._cqRing = MappedFile::MapShared(fd, cq_size, IORING_OFF_CQ_RING);
+    ring._sqeMapping = MappedFile::MapShared(
+        fd, params.sq_entries * sizeof(io_uring_sqe), IORING_OFF_SQES);
+
+    if (!ring._sqRing.IsMapped() || !ring._cqRing.IsMapped()
+        || !ring._sqeMapping.IsMapped())
+    {
+        return std::nullopt;
+    }
+
+    const auto field = [](const MappedFile& mapping, const std::uint32_t pos) {
+        return reinterpret_cast<unsigned*>(
+            static_cast<char*>(mapping.Data()) + pos);
     };
 
-    std::vector<std::string> weaponParts;
+    ring._entries = params.sq_entries;
+    ring._sqTail = field(ring._sqRing, params.sq_off.tail);
+    ring._sqMask = field(ring._sqRing, params.sq_off.ring_mask);
+    ring._sqArray = field(ring._sqRing, params.sq_off.array);
+    ring._sqes = static_cast<io_uring_sqe*>(ring._sqeMapping.Data());
+
+    ring._cqHead = field(ring._cqRing, params.cq_off.head);
+    ring._cqTail = field(ring._cqRing, params.cq_off.tail);
+    ring._cqMask = field(ring._cqRing, params.cq_off.ring_mask);
+    ring._cqes = reinterpret_cast<io_uring_cqe*>(
+        static_cast<char*>(ring._cqRing.Data()) + params.cq_off.cqes);
+
+    return ring;
+}
+
+void ReadRing::QueueRead(const int fd, char* const dest,
+    const std::uint32_t size, const std::uint64_t offset,
+    const std::uint64_t user_data) noexcept
+{
+    // Only this thread writes the tail, the kernel publishes the head
+    const auto tail = std::atomic_ref(*_sqTail).load(std::memory_order_relaxed);
+    const auto index = tail & *_sqMask;
 
-    std::random_device rd;
-    std::mt19937 g(rd());
+    auto& sqe = _sqes[index];
+    sqe = io_uring_sqe{};
+    sqe.opcode = IORING_OP_READ;
+    sqe.fd = fd;
+    sqe.addr = reinterpret_cast<std::uint64_t>(dest);
+    sqe.len = size;
+    sqe.off = offset;
+    sqe.user_data = user_data;
 
-    // Single shuffle vs. multiple shuffles
-    std::shuffle(part_list.begin(), part_list.end(), g);
+    _sqArray[index] = index;
+    std::atomic_ref(*_sqTail).store(tail + 1, std::memory_order_release);
+    ++_queued;
+    ++_inFlight;
+}
 
-    // This nested loop keeps code DRY
-    for (auto part_str : part_list)
+void ReadRing::SubmitAndWait()
+{
+    // The kernel may take fewer entries than offered, the rest stay queued
+    // and go in with the next call
+    do
     {
-        for (const auto& type_str : part_types_list)
+        const auto submitted = ::syscall(__NR_io_uring_enter, _ring.Get(),
+            _queued, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+
+        if (submitted < 0)
         {
-            if (part_str.find(type_str.second) != std::string::npos)
+            if (errno != EINTR)
             {
-                if (type_str.first == Part_Type::Weapon)
+                throw std::runtime_error("io_uring_enter failed");
+            }
+
+            continue;
+        }
+
+        _queued -= static_cast<unsigned>(submitted);
+    } while (_queued != 0);
+}
+
+template<typename Fn>
+void ReadRing::Reap(Fn&& fn)
+{
+    auto head = std::atomic_ref(*_cqHead).load(std::memory_order_relaxed);
+    const auto tail = std::atomic_ref(*_cqTail).load(std::memory_order_acquire);
+
+    for (; head != tail; ++head)
+    {
+        const auto& cqe = _cqes[head & *_cqMask];
+        const auto user_data = cqe.user_data;
+        const auto result = cqe.res;
+
+        // Hand the slot back before the callback can queue more reads, or
+        // throw
+        std::atomic_ref(*_cqHead).store(head + 1, std::memory_order_release);
+        --_inFlight;
+
+        fn(user_data, result);
+    }
+}
+
+void ReadRing::Drain() noexcept
+{
+    while (_inFlight != 0)
+    {
+        const auto submitted = ::syscall(__NR_io_uring_enter, _ring.Get(),
+            _queued, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+
+        if (submitted < 0 && errno != EINTR)
+        {
+            // Nothing more can be waited for
+            return;
+        }
+
+        _queued -= static_cast<unsigned>(std::max<long>(submitted, 0));
+        Reap([](std::uint64_t, std::int32_t) {});
+    }
+}
+
+// Reads all files through one ring, cut into pieces so a large file keeps
+// several reads in flight. Returns false when io_uring is unavailable
+template<typename Fn>
+bool read_files_uring(std::vector<Pending_File>& files, Fn& on_file)
+{
+    constexpr std::size_t piece_size = 1U << 20U;
+
+    auto ring = ReadRing::Create(64);
+
+    if (!ring)
+    {
+        return false;
+    }
+
+    struct Piece
+    {
+        std::size_t file;
+        std::uint64_t offset;
+        std::uint32_t size;
+    };
+
+    std::vector<Piece> pieces;
+    std::vector<std::size_t> remaining(files.size());
+
+    for (std::size_t i = 0; i < files.size(); ++i)
+    {
+        remaining[i] = files[i].size;
+
+        for (std::uint64_t offset = 0; offset < files[i].size;
+             offset += piece_size)
+        {
+            const auto size =
+                std::min<std::uint64_t>(piece_size, files[i].size - offset);
+
+            pieces.push_back({ i, offset, static_cast<std::uint32_t>(size) });
+        }
+
+        // Empty files are complete before any I/O
+        if (files[i].size == 0)
+        {
+            on_file(i);
+        }
+    }
+
+    std::size_t next = 0;
+    unsigned in_flight = 0;
+
+    while (next < pieces.size() || in_flight != 0)
+    {
+        for (; next < pieces.size() && in_flight < ring->Capacity(); ++next)
+        {
+            const auto& piece = pieces[next];
+            const auto& file = files[piece.file];
+
+            ring->QueueRead(file.file.Get(), file.dest + piece.offset,
+                piece.size, piece.offset, next);
+            ++in_flight;
+        }
+
+        // A failed piece must not free buffers the kernel still writes to
+        try
+        {
+            ring->SubmitAndWait();
+            ring->Reap([&](const std::uint64_t id, const std::int32_t result) {
+                --in_flight;
+
+                // Copied, the vector may grow below
+                const auto piece = pieces[id];
+                auto& file = files[piece.file];
+                std::size_t done = 0;
+
+                if (result > 0)
                 {
-                    weaponParts.push_back(std::move(part_str));
+                    done = static_cast<std::size_t>(result);
                 }
-                else if (type_str.first == Part_Type::Wings)
+                else
                 {
-                    if (_smallWings.empty())
-                    {
-                        _smallWings = std::move(part_str);
-                    }
-                    else if (_largeWings.empty())
+                    // Errors (and kernels without IORING_OP_READ) finish
+                    // the piece synchronously, pread_fully throws on a real
+                    // failure
+                    done = pread_fully(file.file.Get(),
+                        file.dest + piece.offset, piece.size, piece.offset,
+                        file.name);
+
+                    if (done == 0)
                     {
-                        _largeWings = std::move(part_str);
+                        std::stringstream err_mesg;
+                        err_mesg << "file: '" << file.name.string()
+                                 << "' changed while loading!";
+                        throw std::runtime_error(err_mesg.str());
                     }
                 }
-                else
+
+                // Short reads queue the rest of their piece
+                if (done < piece.size)
                 {
-                    _parts[type_str.first] = std::move(part_str);
+                    pieces.push_back({ piece.file, piece.offset + done,
+                        static_cast<std::uint32_t>(piece.size - done) });
                 }
-            }
+
+                remaining[piece.file] -= done;
+
+                // Parsing this file overlaps with the reads still in the ring
+                if (remaining[piece.file] == 0)
+                {
+                    on_file(piece.file);
+                }
+            });
+        }
+        catch (...)
+        {
+            ring->Drain();
+            throw;
         }
     }
 
-    // Move into weapons array
-    std::copy_n(std::make_move_iterator(weaponParts.begin()),
-        std::min(_weapons.size(), weaponParts.size()), _weapons.begin());
+    return true;
 }
+#else
+template<typename Fn>
+bool read_files_uring(std::vector<Pending_File>&, Fn&)
+{
+    return false;
+}
+#endif
 
-// Using concepts, pretty trivial example but wanted to use it
-template<typename T>
-concept PathType = std::constructible_from<std::filesystem::path, T>;
-
-int main(const int argc, const char* const argv[]) noexcept
+// Fallback for read_files_uring: a few threads pread whole files while this
+// thread handles each one as soon as it is complete
+template<typename Fn>
+void read_files_pooled(std::vector<Pending_File>& files, Fn& on_file)
 {
-    try
-    {
-        // parts_list parsing is lambda
-        // taking advantage of C++20 templated lambdas and concepts
-        const auto fetch_parts_list = []<PathType T>(T&& fname) {
-            // Using std::filesystem
-            if (!std::filesystem::exists(fname))
+    std::mutex mutex;
+    std::condition_variable completed;
+    std::vector<std::size_t> done;
+    std::exception_ptr error;
+    std::atomic<std::size_t> next{ 0 };
+
+    const auto worker = [&] {
+        try
+        {
+            for (std::size_t i = next++; i < files.size(); i = next++)
             {
-                // Would be nice to have std::format here
-                std::stringstream err_mesg;
-                err_mesg << "file: '" << fname << "' does not exist!";
-                throw std::runtime_error(err_mesg.str());
-            }
+                auto& file = files[i];
 
-            std::ifstream file(fname);
+                if (pread_fully(file.file.Get(), file.dest, file.size, 0,
+                        file.name)
+                    != file.size)
+                {
+                    std::stringstream err_mesg;
+                    err_mesg << "file: '" << file.name.string()
+                             << "' changed while loading!";
+                    throw std::runtime_error(err_mesg.str());
+                }
 
-            // Early exit
-            if (!file.is_open())
-            {
-                // Would be nice to have std::format here
-                std::stringstream err_mesg;
-                err_mesg << "file: '" << fname << "' could not be opened!";
-                throw std::runtime_error(err_mesg.str());
+                const std::lock_guard lock(mutex);
+                done.push_back(i);
+                completed.notify_one();
             }
+        }
+        catch (...)
+        {
+            const std::lock_guard lock(mutex);
+            error = std::current_exception();
+            completed.notify_one();
+        }
+    };
 
-            std::vector<std::string> vec;
+    const auto thread_count = std::min<std::size_t>(
+        files.size(), std::max(4U, std::thread::hardware_concurrency()));
+    std::vector<std::jthread> workers;
 
-            // Reserving the size for the vector (not really useful for such a
-            // small input text, but it will scale)
-            const auto line_count =
-                std::count(std::istreambuf_iterator<char>(file),
-                    std::istreambuf_iterator<char>(), '\n');
+    for (std::size_t i = 0; i < thread_count; ++i)
+    {
+        workers.emplace_back(worker);
+    }
 
-            file.seekg(0, std::ios::beg);
-            vec.reserve(static_cast<unsigned>(line_count));
+    for (std::size_t handled = 0; handled < files.size(); ++handled)
+    {
+        std::unique_lock lock(mutex);
+        completed.wait(lock, [&] { return !done.empty() || error; });
 
-            std::string line;
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
 
-            while (std::getline(file, line))
-            {
-                // Moving line back
-                vec.push_back(std::move(line));
-            }
+        const auto i = done.back();
+        done.pop_back();
+        lock.unlock();
 
-            std::cout << "Parts loaded from: " << fname << '\n';
-            return vec;
-        };
+        on_file(i);
+    }
+}
 
-        // Ternary for short-circuiting
-        const auto parts_filename = argc > 1 ? argv[1] : "vehicle_parts.txt";
+// Appends the line that ends at 'end' (the '\n' or the end of input),
+// dropping a trailing '\r' so CRLF catalogs behave like LF ones
+inline void emit_line(const char* const begin, const char* end,
+    std::vector<std::string_view>& lines)
+{
+    if (end != begin && end[-1] == '\r')
+    {
+        --end;
+    }
+
+    lines.emplace_back(begin, static_cast<std::size_t>(end - begin));
+}
+
+// Line splitting kernels. Each appends every line of 'bytes' to 'lines' with
+// std::getline semantics: a final line without a trailing '\n' still counts
+using Line_Splitter = void (*)(
+    std::string_view bytes, std::vector<std::string_view>& lines);
+
+// Portable fallback, libc's memchr does the scanning
+void split_lines_scalar(
+    const std::string_view bytes, std::vector<std::string_view>& lines)
+{
+    const char* pos = bytes.data();
+    const char* const end = pos + bytes.size();
+
+    while (pos != end)
+    {
+        const auto* const newline = static_cast<const char*>(
+            std::memchr(pos, '\n', static_cast<std::size_t>(end - pos)));
+        const char* const line_end = newline != nullptr ? newline : end;
+
+        emit_line(pos, line_end, lines);
+        pos = newline != nullptr ? newline + 1 : end;
+    }
+}
+
+#if defined(__x86_64__)
+// Compares one block against '\n' and emits a line per set bit, 'line' is the
+// start of the line still open when the block begins
+template<typename Mask>
+inline void emit_block_lines(Mask mask, const char* const block,
+    const char*& line, std::vector<std::string_view>& lines)
+{
+    while (mask != 0)
+    {
+        const char* const newline = block + __builtin_ctzll(mask);
+
+        emit_line(line, newline, lines);
+        line = newline + 1;
+
+        // Clear the lowest set bit
+        mask &= mask - 1;
+    }
+}
+
+// SSE2 is part of the x86-64 baseline, so this one needs no CPU check
+void split_lines_sse2(
+    const std::string_view bytes, std::vector<std::string_view>& lines)
+{
+    const char* line = bytes.data();
+    const char* pos = line;
+    const char* const end = pos + bytes.size();
+    const __m128i newlines = _mm_set1_epi8('\n');
+
+    for (; end - pos >= 16; pos += 16)
+    {
+        const auto block =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+        const auto mask = static_cast<std::uint32_t>(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(block, newlines)));
+
+        emit_block_lines(mask, pos, line, lines);
+    }
+
+    split_lines_scalar({ line, static_cast<std::size_t>(end - line) }, lines);
+}
+
+__attribute__((target("avx2"))) void split_lines_avx2(
+    const std::string_view bytes, std::vector<std::string_view>& lines)
+{
+    const char* line = bytes.data();
+    const char* pos = line;
+    const char* const end = pos + bytes.size();
+    const __m256i newlines = _mm256_set1_epi8('\n');
+
+    // Two blocks per iteration, one 64-bit mask
+    for (; end - pos >= 64; pos += 64)
+    {
+        const auto low =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pos));
+        const auto high =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pos + 32));
+        const auto mask =
+            static_cast<std::uint64_t>(static_cast<std::uint32_t>(
+                _mm256_movemask_epi8(_mm256_cmpeq_epi8(low, newlines))))
+            | static_cast<std::uint64_t>(static_cast<std::uint32_t>(
+                  _mm256_movemask_epi8(_mm256_cmpeq_epi8(high, newlines))))
+                << 32;
+
+        emit_block_lines(mask, pos, line, lines);
+    }
+
+    split_lines_sse2({ line, static_cast<std::size_t>(end - line) }, lines);
+}
+#endif
+
+struct Line_Splitter_Info
+{
+    const char* name;
+    Line_Splitter split;
+};
+
+// Every kernel this CPU can run, slowest first
+std::vector<Line_Splitter_Info> available_line_splitters()
+{
+    std::vector<Line_Splitter_Info> splitters{ { "scalar",
+        split_lines_scalar } };
+
+#if defined(__x86_64__)
+    splitters.push_back({ "sse2", split_lines_sse2 });
+
+    if (__builtin_cpu_supports("avx2"))
+    {
+        splitters.push_back({ "avx2", split_lines_avx2 });
+    }
+#endif
+
+    return splitters;
+}
+
+// Runtime dispatch, resolved once per process
+void split_lines(
+    const std::string_view bytes, std::vector<std::string_view>& lines)
+{
+    static const Line_Splitter best = available_line_splitters().back().split;
+    best(bytes, lines);
+}
+
+// Using hashmap for improved performance
+// Index of a part category. The named values are the built-in categories
+// in print order, a taxonomy file can define others (see Taxonomy)
+enum class Part_Type : uint8_t
+{
+    Engine,
+    Fuselage,
+    Cabin,
+    Armor,
+    Wings,
+    Weapon
+};
+
+struct Part_Type_Info
+{
+    Part_Type type;
+    const char* keyword;
+};
+
+// Keyword of every built-in type, in classification order
+// (would be a great place for 'using enum')
+constexpr std::array<Part_Type_Info, 6> part_types_list{ {
+    { Part_Type::Engine, "engine" },
+    { Part_Type::Fuselage, "fuselage" },
+    { Part_Type::Cabin, "cabin" },
+    { Part_Type::Wings, "wings" },
+    { Part_Type::Armor, "armor" },
+    { Part_Type::Weapon, "weapon" },
+} };
+
+struct Part_Category_Info
+{
+    const char* name;
+
+    // How many parts of this category a ship carries
+    std::size_t slots;
+
+    // One space separated label per slot, or empty to print a plain list
+    const char* labels;
+};
+
+// How the built-in categories print, in Part_Type order
+constexpr std::array<Part_Category_Info, 6> part_categories_list{ {
+    { "Engine", 1, "" },
+    { "Fuselage", 1, "" },
+    { "Cabin", 1, "" },
+    { "Armor", 1, "" },
+    { "Wings", 2, "small large" },
+    { "Weapons", 4, "" },
+} };
+
+// The last space separated token of a part, its head noun ("engine" in
+// "small rocket engine")
+constexpr std::string_view trailing_token(const std::string_view part) noexcept
+{
+    return part.substr(part.find_last_of(" \t") + 1);
+}
+
+// What a part was classified as. Ambiguous parts matched rules of more than
+// one category and were settled by rule priority
+struct Part_Match
+{
+    std::optional<Part_Type> type{};
+    bool ambiguous{ false };
+
+    constexpr bool operator==(const Part_Match& other) const = default;
+};
+
+// Reference classifier, one std::string_view::find per keyword. Kept for the
+// benchmark and as the definition the built-in classifiers have to agree
+// with. Priority rules, the first that applies decides:
+//  1. a trailing keyword names the part ("engine armor" is armor), nothing
+//     else is looked at and the part is never ambiguous
+//  2. otherwise the first type whose keyword appears anywhere wins
+constexpr Part_Match classify_part_find(const std::string_view part) noexcept
+{
+    const auto token = trailing_token(part);
+
+    for (const auto& info : part_types_list)
+    {
+        if (token == info.keyword)
+        {
+            return { info.type, false };
+        }
+    }
+
+    Part_Match match;
+
+    for (const auto& info : part_types_list)
+    {
+        if (part.find(info.keyword) == std::string_view::npos)
+        {
+            continue;
+        }
+
+        if (!match.type)
+        {
+            match.type = info.type;
+        }
+        else if (*match.type != info.type)
+        {
+            match.ambiguous = true;
+            break;
+        }
+    }
+
+    return match;
+}
+
+// Match word kept in column 0 of an automaton row: the best rule matched in
+// that state in the top 16 bits, then the lowest and the highest category
+// of every rule matched there. The category bounds are what tell an
+// ambiguous line apart without a second pass
+constexpr std::uint32_t no_match_word = 0xFFFFFF00;
+
+constexpr std::uint32_t match_word(
+    const std::size_t rule, const Part_Type type) noexcept
+{
+    const auto category = static_cast<std::uint32_t>(type);
+    return static_cast<std::uint32_t>(rule) << 16U | category << 8U | category;
+}
+
+constexpr std::uint32_t merge_match_words(
+    const std::uint32_t a, const std::uint32_t b) noexcept
+{
+    return std::min(a & 0xFFFF0000, b & 0xFFFF0000)
+        | std::min(a & 0xFF00, b & 0xFF00) | std::max(a & 0xFF, b & 0xFF);
+}
+
+// One pass of a row-offset automaton over 'line', merging the match words of
+// every state it goes through
+template<typename Byte_Class>
+constexpr std::uint32_t scan_match_words(const std::uint32_t* const table,
+    const Byte_Class* const classes, const std::string_view line) noexcept
+{
+    std::uint32_t row = 0;
+    std::uint32_t rule = table[0];
+    std::uint32_t low = table[0] & 0xFF00;
+    std::uint32_t high = table[0] & 0xFF;
+
+    for (const auto byte : line)
+    {
+        row = table[row + classes[static_cast<unsigned char>(byte)]];
+
+        const auto match = table[row];
+        rule = std::min(rule, match);
+        low = std::min(low, match & 0xFF00);
+        high = std::max(high, match & 0xFF);
+    }
+
+    return (rule & 0xFFFF0000) | low | high;
+}
+
+// Rule index of a scanned match word, 0xFFFF when nothing matched
+constexpr std::size_t match_word_rule(const std::uint32_t word) noexcept
+{
+    return word >> 16U;
+}
+
+constexpr bool match_word_ambiguous(const std::uint32_t word) noexcept
+{
+    return ((word >> 8U) & 0xFF) != (word & 0xFF);
+}
+
+// Perfect hash over the keywords as whole tokens. The key is the first byte,
+// last byte and length, the compiler searches for a multiplier that spreads
+// the keywords over the slots without collisions
+template<std::size_t Slots>
+class TokenTable
+{
+public:
+    consteval explicit TokenTable(const std::span<const Part_Type_Info> types)
+    {
+        static_assert(std::has_single_bit(Slots) && Slots > 1);
+
+        for (_multiplier = 0x9E3779B1; _multiplier < 0x9E3879B1;
+             _multiplier += 2)
+        {
+            if (Fill(types))
+            {
+                return;
+            }
+        }
+
+        throw "No perfect hash for the part keywords";
+    }
+
+    [[nodiscard]] constexpr std::optional<Part_Type> Find(
+        const std::string_view token) const noexcept
+    {
+        if (token.empty())
+        {
+            return std::nullopt;
+        }
+
+        const auto& slot = _slots[Slot(token)];
+
+        if (slot.keyword != token)
+        {
+            return std::nullopt;
+        }
+
+        return slot.type;
+    }
+
+private:
+    struct Entry
+    {
+        std::string_view keyword{};
+        Part_Type type{};
+    };
+
+    [[nodiscard]] constexpr std::size_t Slot(
+        const std::string_view token) const noexcept
+    {
+        const auto key = static_cast<std::uint32_t>(
+            static_cast<unsigned char>(token.front())
+            | static_cast<unsigned char>(token.back()) << 8
+            | token.size() << 16);
+
+        return (key * _multiplier) >> (32 - std::countr_zero(Slots));
+    }
+
+    constexpr bool Fill(const std::span<const Part_Type_Info> types)
+    {
+        _slots.fill({ std::string_view(""), Part_Type{} });
+
+        for (const auto& info : types)
+        {
+            auto& slot = _slots[Slot(info.keyword)];
+
+            if (!slot.keyword.empty())
+            {
+                return false;
+            }
+
+            slot = { info.keyword, info.type };
+        }
+
+        return true;
+    }
+
+    std::uint32_t _multiplier{};
+    std::array<Entry, Slots> _slots{};
+};
+
+// Byte classes the keyword automaton needs: one per distinct keyword byte,
+// plus the match column and the class shared by every other byte
+consteval std::size_t keyword_row_size()
+{
+    std::array<bool, 256> seen{};
+    std::size_t size = 2;
+
+    for (const auto& info : part_types_list)
+    {
+        for (const auto byte : std::string_view(info.keyword))
+        {
+            if (!std::exchange(seen[static_cast<unsigned char>(byte)], true))
+            {
+                ++size;
+            }
+        }
+    }
+
+    return size;
+}
+
+// At most one trie state per keyword byte, plus the root
+consteval std::size_t keyword_states()
+{
+    std::size_t states = 1;
+
+    for (const auto& info : part_types_list)
+    {
+        states += std::string_view(info.keyword).size();
+    }
+
+    return states;
+}
+
+// Aho-Corasick table over 'count' keywords, with the failure links folded
+// into rows of 'row_size' entries. 'keyword(i)' gives the i-th keyword and
+// its match word, 'classes' maps bytes to columns. There is at most one row
+// per keyword byte, plus the root
+template<typename Keyword, typename Classes>
+constexpr std::vector<std::uint32_t> keyword_table(const std::size_t count,
+    const Keyword& keyword, const Classes& classes, const std::size_t row_size)
+{
+    // Trie first, 0 doubles as "no edge" since nothing points back to root
+    std::vector<std::uint32_t> trie(row_size);
+    trie[0] = no_match_word;
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const auto [text, word] = keyword(i);
+        std::uint32_t row = 0;
+
+        for (const auto byte : text)
+        {
+            const auto edge =
+                row + classes[static_cast<unsigned char>(byte)];
+
+            if (trie[edge] == 0)
+            {
+                const auto child = static_cast<std::uint32_t>(trie.size());
+
+                trie.resize(trie.size() + row_size);
+                trie[edge] = child;
+                trie[child] = no_match_word;
+            }
+
+            row = trie[edge];
+        }
+
+        trie[row] = merge_match_words(trie[row], word);
+    }
+
+    // Breadth-first over the trie: a missing edge takes the failure state's
+    // transition, and every state inherits its failure state's match
+    auto table = trie;
+
+    std::vector<std::uint32_t> failure(trie.size());
+    std::vector<std::uint32_t> queue;
+
+    for (std::size_t c = 1; c < row_size; ++c)
+    {
+        if (trie[c] != 0)
+        {
+            queue.push_back(trie[c]);
+        }
+    }
+
+    for (std::size_t head = 0; head < queue.size(); ++head)
+    {
+        const auto row = queue[head];
+        const auto fail = failure[row];
+
+        table[row] = merge_match_words(table[row], table[fail]);
+
+        for (std::size_t c = 1; c < row_size; ++c)
+        {
+            const auto child = trie[row + c];
+
+            if (child != 0)
+            {
+                failure[child] = table[fail + c];
+                queue.push_back(child);
+            }
+            else
+            {
+                table[row + c] = table[fail + c];
+            }
+        }
+    }
+
+    return table;
+}
+
+// Aho-Corasick automaton over the part keywords, with the failure links
+// folded into a dense transition table. One pass over a line finds every
+// keyword in it, however many keywords there are. Sized by the template
+// arguments so the whole thing can be built by the compiler
+template<std::size_t Keywords, std::size_t RowSize, std::size_t States>
+class KeywordAutomaton
+{
+public:
+    explicit constexpr KeywordAutomaton(std::span<const Part_Type_Info> types);
+
+    // The matching type listed first, like the second rule of
+    // classify_part_find
+    [[nodiscard]] constexpr Part_Match Match(
+        const std::string_view part) const noexcept
+    {
+        const auto word =
+            scan_match_words(_table.data(), _classes.data(), part);
+        const auto rule = match_word_rule(word);
+
+        if (rule >= Keywords)
+        {
+            return {};
+        }
+
+        return { _types[rule], match_word_ambiguous(word) };
+    }
+
+private:
+    static_assert(Keywords < 0xFFFF);
+
+    // Bytes outside every keyword share class 1, column 0 of a row holds
+    // the row's match word
+    std::array<std::uint8_t, 256> _classes{};
+
+    // One row per state, entries are row offsets so the scan needs no
+    // multiply. Failure links are folded in, every entry is a real edge
+    std::array<std::uint32_t, RowSize * States> _table{};
+    std::array<Part_Type, Keywords> _types{};
+};
+
+template<std::size_t Keywords, std::size_t RowSize, std::size_t States>
+constexpr KeywordAutomaton<Keywords, RowSize, States>::KeywordAutomaton(
+    const std::span<const Part_Type_Info> types)
+{
+    _classes.fill(1);
+    std::size_t next_class = 2;
+
+    for (std::size_t i = 0; i < types.size(); ++i)
+    {
+        _types[i] = types[i].type;
+
+        for (const auto byte : std::string_view(types[i].keyword))
+        {
+            auto& byte_class = _classes[static_cast<unsigned char>(byte)];
+
+            if (byte_class == 1)
+            {
+                byte_class = static_cast<std::uint8_t>(next_class++);
+            }
+        }
+    }
+
+    const auto table = keyword_table(
+        types.size(),
+        [types](const std::size_t i) {
+            return std::pair{ std::string_view(types[i].keyword),
+                match_word(i, types[i].type) };
+        },
+        _classes, RowSize);
+
+    std::copy(table.begin(), table.end(), _table.begin());
+}
+
+// Both tables are built by the compiler, nothing to set up at startup and
+// nothing on the heap
+constexpr TokenTable<std::bit_ceil(part_types_list.size())> keyword_tokens(
+    part_types_list);
+constexpr KeywordAutomaton<part_types_list.size(), keyword_row_size(),
+    keyword_states()>
+    keyword_automaton(part_types_list);
+
+// Keyword scanning kernels for parts without a trailing keyword. Each finds
+// the built-in keywords anywhere in 'part' and settles them by priority,
+// exactly like KeywordAutomaton::Match
+using Keyword_Matcher = Part_Match (*)(std::string_view part);
+
+// Portable fallback, one automaton step per byte
+Part_Match match_keywords_automaton(const std::string_view part) noexcept
+{
+    return keyword_automaton.Match(part);
+}
+
+#if defined(__x86_64__)
+// What the SIMD prefilters compare: a keyword can only start where its first
+// byte is and its last byte sits length - 1 further on
+struct Keyword_Fingerprint
+{
+    char first;
+    char last;
+    std::size_t length;
+};
+
+constexpr auto keyword_fingerprints = [] {
+    std::array<Keyword_Fingerprint, part_types_list.size()> prints{};
+
+    for (std::size_t i = 0; i < prints.size(); ++i)
+    {
+        const std::string_view keyword = part_types_list[i].keyword;
+        prints[i] = { keyword.front(), keyword.back(), keyword.size() };
+    }
+
+    return prints;
+}();
+
+constexpr std::size_t longest_keyword =
+    std::ranges::max(keyword_fingerprints, {}, &Keyword_Fingerprint::length)
+        .length;
+
+// The same priority rules as the automaton, from the set of keywords found
+constexpr Part_Match resolve_keywords(const std::uint32_t found) noexcept
+{
+    if (found == 0)
+    {
+        return {};
+    }
+
+    const auto type = part_types_list[std::countr_zero(found)].type;
+
+    for (auto rest = found & (found - 1); rest != 0; rest &= rest - 1)
+    {
+        if (part_types_list[std::countr_zero(rest)].type != type)
+        {
+            return { type, true };
+        }
+    }
+
+    return { type, false };
+}
+
+// Nothing found later can change the outcome once the first keyword is in
+// and the part is already ambiguous
+constexpr bool keywords_settled(const std::uint32_t found) noexcept
+{
+    return (found & 1U) != 0 && resolve_keywords(found).ambiguous;
+}
+
+// Checks the candidate start positions in 'mask' against the whole keyword
+template<typename Mask>
+inline bool verify_keyword(
+    Mask mask, const char* const block, const std::size_t index) noexcept
+{
+    while (mask != 0)
+    {
+        if (std::memcmp(block + __builtin_ctzll(mask),
+                part_types_list[index].keyword,
+                keyword_fingerprints[index].length)
+            == 0)
+        {
+            return true;
+        }
+
+        // Clear the lowest set bit
+        mask &= mask - 1;
+    }
+
+    return false;
+}
+
+// Blocks that would read past the end of the part are copied to a zeroed
+// buffer first, no keyword byte is 0 so the padding never matches
+template<std::size_t Block>
+inline const char* keyword_block(const std::string_view part,
+    const std::size_t pos, std::array<char, Block + longest_keyword>& padded)
+{
+    if (pos + Block + longest_keyword - 1 <= part.size())
+    {
+        return part.data() + pos;
+    }
+
+    padded.fill(0);
+    std::memcpy(padded.data(), part.data() + pos, part.size() - pos);
+    return padded.data();
+}
+
+// One block of candidate start positions, loaded once. Match compares the
+// first and last byte of a keyword at every position and returns a bit per
+// position where both agree. Only pointers and masks cross the calls, so
+// no vector is passed in a register the caller's target may lack
+struct Sse2_Block
+{
+    static constexpr std::size_t width = 16;
+
+    explicit Sse2_Block(const char* const block) noexcept
+        : firsts(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block)))
+    {
+    }
+
+    [[nodiscard]] std::uint32_t Match(const char* const lasts,
+        const char first, const char last) const noexcept
+    {
+        const auto ends =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(lasts));
+
+        return static_cast<std::uint32_t>(_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(firsts, _mm_set1_epi8(first)),
+                _mm_cmpeq_epi8(ends, _mm_set1_epi8(last)))));
+    }
+
+    __m128i firsts;
+};
+
+struct Avx2_Block
+{
+    static constexpr std::size_t width = 32;
+
+    __attribute__((target("avx2"))) explicit Avx2_Block(
+        const char* const block) noexcept
+        : firsts(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(block)))
+    {
+    }
+
+    __attribute__((target("avx2"))) [[nodiscard]] std::uint32_t Match(
+        const char* const lasts, const char first,
+        const char last) const noexcept
+    {
+        const auto ends =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lasts));
+
+        return static_cast<std::uint32_t>(_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(firsts, _mm256_set1_epi8(first)),
+                _mm256_cmpeq_epi8(ends, _mm256_set1_epi8(last)))));
+    }
+
+    __m256i firsts;
+};
+
+// Teddy-style prefilter, Block::width start positions per block
+template<typename Block>
+Part_Match match_keywords_blocks(const std::string_view part) noexcept
+{
+    std::array<char, Block::width + longest_keyword> padded{};
+    std::uint32_t found = 0;
+
+    for (std::size_t pos = 0; pos < part.size(); pos += Block::width)
+    {
+        const char* const block =
+            keyword_block<Block::width>(part, pos, padded);
+        const Block firsts(block);
+
+        for (std::size_t k = 0; k < keyword_fingerprints.size(); ++k)
+        {
+            const auto& print = keyword_fingerprints[k];
+
+            if ((found >> k & 1U) != 0)
+            {
+                continue;
+            }
+
+            const auto mask =
+                firsts.Match(block + print.length - 1, print.first, print.last);
+
+            if (mask != 0 && verify_keyword(mask, block, k))
+            {
+                found |= 1U << k;
+            }
+        }
+
+        if (keywords_settled(found))
+        {
+            break;
+        }
+    }
+
+    return resolve_keywords(found);
+}
+
+// SSE2 is part of the x86-64 baseline, so this one needs no CPU check
+Part_Match match_keywords_sse2(const std::string_view part) noexcept
+{
+    return match_keywords_blocks<Sse2_Block>(part);
+}
+
+// Flattened so the whole scan is compiled for AVX2, not just the block
+// operations
+__attribute__((target("avx2"), flatten)) Part_Match match_keywords_avx2(
+    const std::string_view part) noexcept
+{
+    return match_keywords_blocks<Avx2_Block>(part);
+}
+#endif
+
+struct Keyword_Matcher_Info
+{
+    const char* name;
+    Keyword_Matcher match;
+};
+
+// Every kernel this CPU can run, slowest first
+std::vector<Keyword_Matcher_Info> available_keyword_matchers()
+{
+    std::vector<Keyword_Matcher_Info> matchers{ { "automaton",
+        match_keywords_automaton } };
+
+#if defined(__x86_64__)
+    matchers.push_back({ "sse2", match_keywords_sse2 });
+
+    if (__builtin_cpu_supports("avx2"))
+    {
+        matchers.push_back({ "avx2", match_keywords_avx2 });
+    }
+#endif
+
+    return matchers;
+}
+
+// Runtime dispatch, resolved once per process
+Part_Match match_keywords(const std::string_view part) noexcept
+{
+    static const Keyword_Matcher best =
+        available_keyword_matchers().back().match;
+    return best(part);
+}
+
+// Built-in categories only: a trailing keyword is decisive after a hash and
+// a compare, anything else gets the full scan
+constexpr Part_Match classify_part_builtin(const std::string_view part) noexcept
+{
+    if (const auto type = keyword_tokens.Find(trailing_token(part)))
+    {
+        return { type, false };
+    }
+
+    if (std::is_constant_evaluated())
+    {
+        return keyword_automaton.Match(part);
+    }
+
+    return match_keywords(part);
+}
+
+static_assert(classify_part_builtin("small rocket engine")
+    == Part_Match{ Part_Type::Engine, false });
+static_assert(classify_part_builtin("engine armor")
+    == Part_Match{ Part_Type::Armor, false });
+static_assert(classify_part_builtin("wings for the cabin, mk2")
+    == Part_Match{ Part_Type::Cabin, true });
+static_assert(classify_part_builtin("cabin, mk2")
+    == Part_Match{ Part_Type::Cabin, false });
+static_assert(!classify_part_builtin("hull plating").type);
+
+// Anything that hands out parts already grouped by type
+template<typename T>
+concept PartSource = requires(const T& source, const Part_Type type,
+    const std::size_t index)
+{
+    {
+        source.Count(type)
+    }
+    ->std::convertible_to<std::size_t>;
+    {
+        source.Part(type, index)
+    }
+    ->std::convertible_to<std::string_view>;
+};
+
+// Dense number of a part within its source, the parts of each type take up
+// one contiguous range of ids in type order
+using Part_Id = std::uint32_t;
+
+// A PartSource that also numbers its parts and looks them up by id
+template<typename T>
+concept IndexedPartSource = PartSource<T>
+    && requires(const T& source, const Part_Type type, const Part_Id id)
+{
+    {
+        source.FirstId(type)
+    }
+    ->std::convertible_to<Part_Id>;
+    {
+        source.Part(id)
+    }
+    ->std::convertible_to<std::string_view>;
+};
+
+// 64-bit hash of a part line's bytes, eight bytes per step
+inline std::uint64_t hash_bytes(const std::string_view bytes) noexcept
+{
+    constexpr std::uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+    constexpr std::uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+
+    const char* pos = bytes.data();
+    const char* const end = pos + bytes.size();
+    std::uint64_t hash = bytes.size() * prime1;
+
+    const auto round = [&hash](const std::uint64_t word) {
+        hash = std::rotl(hash ^ (word * prime2), 31) * prime1;
+    };
+
+    for (; end - pos >= 8; pos += 8)
+    {
+        std::uint64_t word = 0;
+        std::memcpy(&word, pos, sizeof(word));
+        round(word);
+    }
+
+    if (pos != end)
+    {
+        std::uint64_t word = 0;
+        std::memcpy(&word, pos, static_cast<std::size_t>(end - pos));
+        round(word);
+    }
+
+    // Final avalanche, the low bits pick hash table slots
+    hash ^= hash >> 33U;
+    hash *= 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 33U;
+    hash *= 0xC4CEB9FE1A85EC53ULL;
+    hash ^= hash >> 33U;
+    return hash;
+}
+
+// Locale-free tolower, bytes outside 'A'-'Z' pass through
+constexpr char lower_ascii(const char c) noexcept
+{
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c | 0x20) : c;
+}
+
+// fold_part() stores whole 16-byte blocks, 'out' needs this much room past
+// the length of the part
+constexpr std::size_t fold_slack = 16;
+
+// Folds ASCII to lower case, turns tabs and '\r' into spaces, collapses runs
+// of them into one and drops them at both ends, so "Laser  Cannon\tWEAPON"
+// reads "laser cannon weapon". Writes at most part.size() bytes to 'out',
+// returns how many
+inline std::size_t fold_part(
+    const std::string_view part, char* const out) noexcept
+{
+    const char* pos = part.data();
+    const char* const end = pos + part.size();
+    char* dest = out;
+
+    // As if after a space, so leading whitespace is dropped
+    bool after_space = true;
+
+    const auto fold_byte = [&dest, &after_space](const char c) {
+        if (c == ' ' || c == '\t' || c == '\r')
+        {
+            if (!after_space)
+            {
+                *dest++ = ' ';
+            }
+
+            after_space = true;
+            return;
+        }
+
+        *dest++ = lower_ascii(c);
+        after_space = false;
+    };
+
+#if defined(__x86_64__)
+    // 16 bytes at a time while no two whitespace bytes touch, which is
+    // nearly always. Blocks where they do are folded byte by byte
+    const auto below_upper = _mm_set1_epi8('A' - 1);
+    const auto above_upper = _mm_set1_epi8('Z' + 1);
+    const auto case_bit = _mm_set1_epi8(0x20);
+    const auto space = _mm_set1_epi8(' ');
+    const auto tab = _mm_set1_epi8('\t');
+    const auto carriage_return = _mm_set1_epi8('\r');
+
+    // Folds the first 'count' bytes of 'block', which came from 'pos'
+    const auto fold_block = [&](__m128i block, const int count) {
+        const auto valid = (1U << static_cast<unsigned>(count)) - 1;
+
+        // Bytes from 0x80 compare as negative, they are never upper case
+        const auto upper = _mm_and_si128(_mm_cmpgt_epi8(block, below_upper),
+            _mm_cmplt_epi8(block, above_upper));
+        const auto blank = _mm_or_si128(_mm_cmpeq_epi8(block, space),
+            _mm_or_si128(_mm_cmpeq_epi8(block, tab),
+                _mm_cmpeq_epi8(block, carriage_return)));
+        const auto blanks =
+            static_cast<unsigned>(_mm_movemask_epi8(blank)) & valid;
+
+        if ((blanks & ((blanks << 1U) | (after_space ? 1U : 0U))) != 0)
+        {
+            for (int i = 0; i < count; ++i)
+            {
+                fold_byte(pos[i]);
+            }
+
+            return;
+        }
+
+        block = _mm_or_si128(block, _mm_and_si128(upper, case_bit));
+        block = _mm_or_si128(
+            _mm_and_si128(blank, space), _mm_andnot_si128(blank, block));
+
+        // Lanes past 'count' land in the slack and get overwritten
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), block);
+        dest += count;
+        after_space = ((blanks >> static_cast<unsigned>(count - 1)) & 1U) != 0;
+    };
+
+    for (; end - pos >= 16; pos += 16)
+    {
+        fold_block(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos)), 16);
+    }
+
+    // The tail goes through a zeroed copy, the line may end a mapping
+    if (pos != end)
+    {
+        std::array<char, 16> tail{};
+        std::memcpy(tail.data(), pos, static_cast<std::size_t>(end - pos));
+        fold_block(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(tail.data())),
+            static_cast<int>(end - pos));
+        pos = end;
+    }
+#endif
+
+    for (; pos != end; ++pos)
+    {
+        fold_byte(*pos);
+    }
+
+    // Only a space can have been written last
+    if (after_space && dest != out)
+    {
+        --dest;
+    }
+
+    return static_cast<std::size_t>(dest - out);
+}
+
+// fold_part() for the literal bytes of a regex: lower case, and a run of
+// spaces, tabs or '\r' as one space, since that is all a folded line can
+// hold. Escapes stay escapes, except that an escaped capital is a literal
+// and becomes the plain small letter: "\S" must not turn into "\s"
+std::string fold_regex(const std::string_view regex)
+{
+    std::string folded;
+    folded.reserve(regex.size());
+
+    bool after_space = false;
+
+    for (std::size_t i = 0; i < regex.size(); ++i)
+    {
+        const auto c = regex[i];
+
+        if (c == '\\' && i + 1 < regex.size())
+        {
+            const auto escaped = regex[++i];
+
+            if (escaped >= 'A' && escaped <= 'Z')
+            {
+                folded += lower_ascii(escaped);
+            }
+            else
+            {
+                (folded += c) += escaped;
+            }
+
+            after_space = false;
+            continue;
+        }
+
+        if (c == ' ' || c == '\t' || c == '\r')
+        {
+            if (!after_space)
+            {
+                folded += ' ';
+            }
+
+            after_space = true;
+            continue;
+        }
+
+        folded += lower_ascii(c);
+        after_space = false;
+    }
+
+    return folded;
+}
+
+// Keywords and regular expressions compiled into two DFAs that find the
+// first of them occurring anywhere in a line, one pass each however many
+// there are. Keywords go through an Aho-Corasick table that grows with their
+// bytes, only the regexes need the subset construction and its state cap.
+// Regexes support . [] [^] | () * + ? and the \d \w \s classes, a backslash
+// escapes anything else
+class MatchDfa
+{
+public:
+    struct Pattern
+    {
+        std::string text{};
+        bool regex{ false };
+
+        // Category a line containing the pattern belongs to
+        Part_Type type{};
+    };
+
+    // Throws when a pattern does not parse or the regex DFA gets too big
+    explicit MatchDfa(std::span<const Pattern> patterns);
+
+    // Throws with the reason when 'regex' does not parse or matches an
+    // empty string
+    static void Validate(std::string_view regex);
+
+    // The type of the first pattern that occurs in 'line'
+    [[nodiscard]] Part_Match Match(const std::string_view line) const noexcept
+    {
+        const auto word = merge_match_words(
+            _keywords.Scan(line), _regexes.Scan(line));
+        const auto pattern = match_word_rule(word);
+
+        if (pattern >= _types.size())
+        {
+            return {};
+        }
+
+        return { _types[pattern], match_word_ambiguous(word) };
+    }
+
+    static constexpr std::size_t max_patterns = 0xFFFF;
+    static constexpr std::size_t max_regex_states = 4096;
+
+private:
+    class Nfa;
+
+    // Same layout as KeywordAutomaton: bytes no pattern tells apart share a
+    // column, column 0 of a row holds the row's match word and entries are
+    // row offsets
+    struct Automaton
+    {
+        std::array<std::uint16_t, 256> classes{};
+
+        // Left empty when there is no pattern of its kind
+        std::vector<std::uint32_t> table{};
+
+        [[nodiscard]] std::uint32_t Scan(
+            const std::string_view line) const noexcept
+        {
+            return table.empty()
+                ? no_match_word
+                : scan_match_words(table.data(), classes.data(), line);
+        }
+    };
+
+    // Both keep the index of a pattern in 'patterns' as its priority
+    static Automaton CompileKeywords(std::span<const Pattern> patterns);
+    static Automaton CompileRegexes(std::span<const Pattern> patterns);
+
+    Automaton _keywords{};
+    Automaton _regexes{};
+    std::vector<Part_Type> _types{};
+};
+
+// Thompson construction, every fragment has one entry and one exit node and
+// node 0 leads to every pattern
+class MatchDfa::Nfa
+{
+public:
+    struct Node
+    {
+        // Byte set of the one consuming edge, -1 for none
+        int charset{ -1 };
+        std::uint32_t next{ 0 };
+        std::vector<std::uint32_t> epsilon{};
+        std::uint32_t accept{ no_match_word };
+    };
+
+    Nfa() { NewNode(); }
+
+    // Makes 'pattern' reachable from node 0, accepting with 'index'
+    void Add(const Pattern& pattern, std::uint32_t index);
+
+    std::vector<Node> nodes{};
+    std::vector<std::bitset<256>> charsets{};
+
+private:
+    struct Fragment
+    {
+        std::uint32_t entry{ 0 };
+        std::uint32_t exit{ 0 };
+    };
+
+    std::uint32_t NewNode()
+    {
+        nodes.emplace_back();
+        return static_cast<std::uint32_t>(nodes.size() - 1);
+    }
+
+    void Link(const std::uint32_t from, const std::uint32_t to)
+    {
+        nodes[from].epsilon.push_back(to);
+    }
+
+    Fragment Edge(const std::bitset<256>& set);
+
+    // Recursive descent, lowest precedence first
+    Fragment Alternation();
+    Fragment Concatenation();
+    Fragment Repetition();
+    Fragment Atom();
+    std::bitset<256> Class();
+    std::bitset<256> Escape();
+
+    // What is left of the regex being parsed
+    std::string_view _rest{};
+};
+
+void MatchDfa::Nfa::Add(const Pattern& pattern, const std::uint32_t index)
+{
+    Fragment fragment;
+
+    if (pattern.regex)
+    {
+        _rest = pattern.text;
+        fragment = Alternation();
+
+        if (!_rest.empty())
+        {
+            throw std::runtime_error("unbalanced ')'");
+        }
+    }
+    else
+    {
+        fragment.entry = fragment.exit = NewNode();
+
+        for (const auto byte : pattern.text)
+        {
+            const auto edge =
+                Edge(std::bitset<256>().set(static_cast<unsigned char>(byte)));
+
+            Link(fragment.exit, edge.entry);
+            fragment.exit = edge.exit;
+        }
+    }
+
+    Link(0, fragment.entry);
+    nodes[fragment.exit].accept = merge_match_words(
+        nodes[fragment.exit].accept, match_word(index, pattern.type));
+}
+
+MatchDfa::Nfa::Fragment MatchDfa::Nfa::Edge(const std::bitset<256>& set)
+{
+    const auto entry = NewNode();
+    const auto exit = NewNode();
+
+    nodes[entry].charset = static_cast<int>(charsets.size());
+    nodes[entry].next = exit;
+    charsets.push_back(set);
+    return { entry, exit };
+}
+
+MatchDfa::Nfa::Fragment MatchDfa::Nfa::Alternation()
+{
+    auto left = Concatenation();
+
+    while (!_rest.empty() && _rest.front() == '|')
+    {
+        _rest.remove_prefix(1);
+
+        const auto right = Concatenation();
+        const auto entry = NewNode();
+        const auto exit = NewNode();
+
+        Link(entry, left.entry);
+        Link(entry, right.entry);
+        Link(left.exit, exit);
+        Link(right.exit, exit);
+        left = { entry, exit };
+    }
+
+    return left;
+}
+
+MatchDfa::Nfa::Fragment MatchDfa::Nfa::Concatenation()
+{
+    const auto empty = NewNode();
+    Fragment whole{ empty, empty };
+
+    while (!_rest.empty() && _rest.front() != '|' && _rest.front() != ')')
+    {
+        const auto next = Repetition();
+
+        Link(whole.exit, next.entry);
+        whole.exit = next.exit;
+    }
+
+    return whole;
+}
+
+MatchDfa::Nfa::Fragment MatchDfa::Nfa::Repetition()
+{
+    auto fragment = Atom();
+
+    while (!_rest.empty()
+        && (_rest.front() == '*' || _rest.front() == '+'
+            || _rest.front() == '?'))
+    {
+        const auto op = _rest.front();
+        const auto exit = NewNode();
+
+        _rest.remove_prefix(1);
+        Link(fragment.exit, exit);
+
+        // '*' and '+' loop back, '*' and '?' may skip the fragment
+        if (op != '?')
+        {
+            Link(fragment.exit, fragment.entry);
+        }
+
+        if (op != '+')
+        {
+            const auto entry = NewNode();
+
+            Link(entry, fragment.entry);
+            Link(entry, exit);
+            fragment.entry = entry;
+        }
+
+        fragment.exit = exit;
+    }
+
+    return fragment;
+}
+
+MatchDfa::Nfa::Fragment MatchDfa::Nfa::Atom()
+{
+    const auto head = _rest.front();
+    _rest.remove_prefix(1);
+
+    switch (head)
+    {
+    case '(':
+    {
+        const auto inner = Alternation();
+
+        if (_rest.empty() || _rest.front() != ')')
+        {
+            throw std::runtime_error("unbalanced '('");
+        }
+
+        _rest.remove_prefix(1);
+        return inner;
+    }
+    case '*':
+    case '+':
+    case '?':
+        throw std::runtime_error("nothing to repeat");
+    case '[':
+        return Edge(Class());
+    case '.':
+        return Edge(std::bitset<256>().set());
+    case '\\':
+        return Edge(Escape());
+    default:
+        return Edge(std::bitset<256>().set(static_cast<unsigned char>(head)));
+    }
+}
+
+std::bitset<256> MatchDfa::Nfa::Class()
+{
+    const auto negate = !_rest.empty() && _rest.front() == '^';
+    std::bitset<256> set;
+
+    if (negate)
+    {
+        _rest.remove_prefix(1);
+    }
+
+    // A ']' right at the start is a literal
+    for (auto first = true;; first = false)
+    {
+        if (_rest.empty())
+        {
+            throw std::runtime_error("unbalanced '['");
+        }
+
+        const auto low = static_cast<unsigned char>(_rest.front());
+        _rest.remove_prefix(1);
+
+        if (low == ']' && !first)
+        {
+            break;
+        }
+
+        if (low == '\\')
+        {
+            set |= Escape();
+        }
+        else if (_rest.size() >= 2 && _rest[0] == '-' && _rest[1] != ']')
+        {
+            const auto high = static_cast<unsigned char>(_rest[1]);
+            _rest.remove_prefix(2);
+
+            if (high < low)
+            {
+                throw std::runtime_error("reversed range in '[]'");
+            }
+
+            for (unsigned byte = low; byte <= high; ++byte)
+            {
+                set.set(byte);
+            }
+        }
+        else
+        {
+            set.set(low);
+        }
+    }
+
+    return negate ? ~set : set;
+}
+
+std::bitset<256> MatchDfa::Nfa::Escape()
+{
+    if (_rest.empty())
+    {
+        throw std::runtime_error("trailing '\\'");
+    }
+
+    const auto escaped = static_cast<unsigned char>(_rest.front());
+    _rest.remove_prefix(1);
+
+    std::bitset<256> set;
+
+    for (unsigned byte = 0; byte < set.size(); ++byte)
+    {
+        const auto c = static_cast<int>(byte);
+
+        if ((escaped == 'd' && std::isdigit(c))
+            || (escaped == 'w' && (std::isalnum(c) || c == '_'))
+            || (escaped == 's' && std::isspace(c)))
+        {
+            set.set(byte);
+        }
+    }
+
+    if (escaped != 'd' && escaped != 'w' && escaped != 's')
+    {
+        set.set(escaped);
+    }
+
+    return set;
+}
+
+void MatchDfa::Validate(const std::string_view regex)
+{
+    Nfa nfa;
+    nfa.Add({ std::string(regex), true }, 0);
+
+    // Matching the empty string would match every line, so the accepting
+    // node must not be reachable from node 0 without consuming a byte
+    std::vector<bool> seen(nfa.nodes.size());
+
+    for (std::vector<std::uint32_t> pending{ 0 }; !pending.empty();)
+    {
+        const auto node = pending.back();
+        pending.pop_back();
+
+        if (nfa.nodes[node].accept != no_match_word)
+        {
+            throw std::runtime_error("the regex matches an empty string");
+        }
+
+        if (!seen[node])
+        {
+            seen[node] = true;
+            pending.insert(pending.end(), nfa.nodes[node].epsilon.begin(),
+                nfa.nodes[node].epsilon.end());
+        }
+    }
+}
+
+MatchDfa::MatchDfa(const std::span<const Pattern> patterns)
+{
+    if (patterns.size() > max_patterns)
+    {
+        throw std::runtime_error("too many patterns for one DFA");
+    }
+
+    for (const auto& pattern : patterns)
+    {
+        _types.push_back(pattern.type);
+    }
+
+    _keywords = CompileKeywords(patterns);
+    _regexes = CompileRegexes(patterns);
+}
+
+MatchDfa::Automaton MatchDfa::CompileKeywords(
+    const std::span<const Pattern> patterns)
+{
+    Automaton automaton;
+    std::vector<std::size_t> keywords;
+    std::size_t bytes = 0;
+    std::uint16_t next_class = 2;
+
+    // Bytes outside every keyword share class 1
+    automaton.classes.fill(1);
+
+    for (std::size_t i = 0; i < patterns.size(); ++i)
+    {
+        if (patterns[i].regex)
+        {
+            continue;
+        }
+
+        keywords.push_back(i);
+        bytes += patterns[i].text.size();
+
+        for (const auto byte : patterns[i].text)
+        {
+            auto& byte_class =
+                automaton.classes[static_cast<unsigned char>(byte)];
+
+            if (byte_class == 1)
+            {
+                byte_class = next_class++;
+            }
+        }
+    }
+
+    if (keywords.empty())
+    {
+        return automaton;
+    }
+
+    // Row offsets are 32 bits
+    if ((bytes + 1) * next_class > std::numeric_limits<std::uint32_t>::max())
+    {
+        throw std::runtime_error("too many keyword bytes for one DFA");
+    }
+
+    automaton.table = keyword_table(
+        keywords.size(),
+        [&](const std::size_t i) {
+            const auto& pattern = patterns[keywords[i]];
+            return std::pair{ std::string_view(pattern.text),
+                match_word(keywords[i], pattern.type) };
+        },
+        automaton.classes, next_class);
+
+    return automaton;
+}
+
+MatchDfa::Automaton MatchDfa::CompileRegexes(
+    const std::span<const Pattern> patterns)
+{
+    Automaton automaton;
+    Nfa nfa;
+
+    for (std::size_t i = 0; i < patterns.size(); ++i)
+    {
+        if (patterns[i].regex)
+        {
+            nfa.Add(patterns[i], static_cast<std::uint32_t>(i));
+        }
+    }
+
+    if (nfa.nodes.size() == 1)
+    {
+        return automaton;
+    }
+
+    // Split the bytes into classes, one charset at a time
+    std::array<std::uint16_t, 256> byte_class{};
+    std::size_t class_count = 1;
+
+    for (const auto& set : nfa.charsets)
+    {
+        std::vector<int> split(class_count * 2, -1);
+        class_count = 0;
+
+        for (std::size_t byte = 0; byte < byte_class.size(); ++byte)
+        {
+            auto& target = split[byte_class[byte] * 2U + set[byte]];
+
+            if (target < 0)
+            {
+                target = static_cast<int>(class_count++);
+            }
+
+            byte_class[byte] = static_cast<std::uint16_t>(target);
+        }
+    }
+
+    const auto row_size = static_cast<std::uint32_t>(class_count + 1);
+    std::vector<unsigned> representative(class_count);
+
+    for (unsigned byte = 0; byte < byte_class.size(); ++byte)
+    {
+        automaton.classes[byte] =
+            static_cast<std::uint16_t>(byte_class[byte] + 1);
+        representative[byte_class[byte]] = byte;
+    }
+
+    // Subset construction. Node 0 is in every state, that is what lets a
+    // match start anywhere in the line
+    const auto closure = [&nfa](std::vector<std::uint32_t>&& pending) {
+        std::vector<bool> seen(nfa.nodes.size());
+        std::vector<std::uint32_t> states;
+
+        while (!pending.empty())
+        {
+            const auto node = pending.back();
+            pending.pop_back();
+
+            if (!seen[node])
+            {
+                seen[node] = true;
+                states.push_back(node);
+                pending.insert(pending.end(), nfa.nodes[node].epsilon.begin(),
+                    nfa.nodes[node].epsilon.end());
+            }
+        }
+
+        std::sort(states.begin(), states.end());
+        return states;
+    };
+
+    std::map<std::vector<std::uint32_t>, std::uint32_t> rows;
+    std::vector<std::vector<std::uint32_t>> states;
+
+    const auto row_of = [&](std::vector<std::uint32_t>&& state) {
+        const auto [pos, inserted] = rows.try_emplace(
+            state, static_cast<std::uint32_t>(states.size() * row_size));
+
+        if (inserted)
+        {
+            if (states.size() == max_regex_states)
+            {
+                throw std::runtime_error("too many states in the taxonomy "
+                                         "DFA, simplify its regex rules");
+            }
+
+            states.push_back(std::move(state));
+        }
+
+        return pos->second;
+    };
+
+    row_of(closure({ 0 }));
+
+    for (std::size_t i = 0; i < states.size(); ++i)
+    {
+        automaton.table.resize((i + 1) * row_size, no_match_word);
+
+        for (const auto node : states[i])
+        {
+            automaton.table[i * row_size] = merge_match_words(
+                automaton.table[i * row_size], nfa.nodes[node].accept);
+        }
+
+        for (std::size_t c = 0; c < class_count; ++c)
+        {
+            std::vector<std::uint32_t> next{ 0 };
+
+            for (const auto node : states[i])
+            {
+                const auto& edge = nfa.nodes[node];
+
+                if (edge.charset >= 0
+                    && nfa.charsets[static_cast<std::size_t>(edge.charset)]
+                                   [representative[c]])
+                {
+                    next.push_back(edge.next);
+                }
+            }
+
+            // May add a state, so nothing may still point into 'states'
+            const auto row = row_of(closure(std::move(next)));
+            automaton.table[i * row_size + c + 1] = row;
+        }
+    }
+
+    return automaton;
+}
+
+// A keyword prepared for Myers' bit-parallel edit distance: bit i of
+// 'equal[c]' is set when the keyword's byte i is c
+struct Fuzzy_Keyword
+{
+    std::array<std::uint64_t, 256> equal{};
+    std::uint64_t last_bit{ 0 };
+    std::size_t length{ 0 };
+    std::size_t max_distance{ 0 };
+    Part_Type type{};
+};
+
+// One machine word per keyword, so up to 64 bytes long. Short keywords get
+// at most a third of their length in edits, "cabin" never matches "cab"
+constexpr std::size_t max_fuzzy_keyword = 64;
+
+constexpr Fuzzy_Keyword make_fuzzy_keyword(const std::string_view text,
+    const Part_Type type, const std::size_t max_distance) noexcept
+{
+    Fuzzy_Keyword keyword{};
+
+    for (std::size_t i = 0; i < text.size(); ++i)
+    {
+        keyword.equal[static_cast<unsigned char>(text[i])] |=
+            std::uint64_t{ 1 } << i;
+    }
+
+    keyword.last_bit = std::uint64_t{ 1 } << (text.size() - 1);
+    keyword.length = text.size();
+    keyword.max_distance = std::min(max_distance, text.size() / 3);
+    keyword.type = type;
+    return keyword;
+}
+
+// The last column of Myers' edit distance matrix for one keyword, as
+// vertical +1 and -1 bits, plus the bottom row value
+struct Fuzzy_Column
+{
+    std::uint64_t plus{ ~std::uint64_t{ 0 } };
+    std::uint64_t minus{ 0 };
+    std::size_t score{ 0 };
+
+    // Lowest score at a word ending so far
+    std::size_t best{ 0 };
+
+    // Adds the column for byte 'c', 'word_end' when a space, a tab or the
+    // end of the part follows it
+    constexpr void Step(const Fuzzy_Keyword& keyword, const unsigned char c,
+        const bool word_end) noexcept
+    {
+        const auto equal = keyword.equal[c];
+        const auto vertical = equal | minus;
+        const auto horizontal = (((equal & plus) + plus) ^ plus) | equal;
+        auto horizontal_plus = minus | ~(horizontal | plus);
+        auto horizontal_minus = plus & horizontal;
+
+        // Branch free, the bottom row goes up and down unpredictably
+        score += (horizontal_plus & keyword.last_bit) != 0 ? 1U : 0U;
+        score -= (horizontal_minus & keyword.last_bit) != 0 ? 1U : 0U;
+
+        // No carry in at the bottom, a match may start anywhere
+        horizontal_plus <<= 1U;
+        horizontal_minus <<= 1U;
+        plus = horizontal_minus | ~(vertical | horizontal_plus);
+        minus = horizontal_plus & vertical;
+
+        if (word_end)
+        {
+            best = std::min(best, score);
+        }
+    }
+};
+
+constexpr bool fuzzy_word_end(
+    const std::string_view part, const std::size_t i) noexcept
+{
+    return i + 1 == part.size() || part[i + 1] == ' ' || part[i + 1] == '\t';
+}
+
+// Fewest edits turning the keyword into a word ending of 'part'
+constexpr std::size_t fuzzy_distance(
+    const Fuzzy_Keyword& keyword, const std::string_view part) noexcept
+{
+    Fuzzy_Column column{};
+    column.score = keyword.length;
+    column.best = keyword.length;
+
+    for (std::size_t i = 0; i < part.size(); ++i)
+    {
+        column.Step(keyword, static_cast<unsigned char>(part[i]),
+            fuzzy_word_end(part, i));
+    }
+
+    return column.best;
+}
+
+static_assert(fuzzy_distance(make_fuzzy_keyword("weapon", Part_Type{}, 2),
+                  "laser wepaon")
+    == 2);
+static_assert(fuzzy_distance(make_fuzzy_keyword("fuselage", Part_Type{}, 2),
+                  "big fusilage mk2")
+    == 1);
+static_assert(fuzzy_distance(make_fuzzy_keyword("engine", Part_Type{}, 2),
+                  "rocket engines")
+    == 1);
+
+// The closest keyword within its distance. Ties between categories go to
+// the earlier keyword and leave the part ambiguous
+inline Part_Match match_fuzzy(const std::span<const Fuzzy_Keyword> keywords,
+    const std::string_view part) noexcept
+{
+    // Keywords walk the part side by side, a column only depends on its own
+    // previous one so their dependency chains overlap
+    constexpr std::size_t group_size = 8;
+
+    Part_Match best{};
+    std::size_t best_distance = 0;
+
+    for (std::size_t first = 0; first < keywords.size(); first += group_size)
+    {
+        const auto group = keywords.subspan(
+            first, std::min(group_size, keywords.size() - first));
+        std::array<Fuzzy_Column, group_size> columns{};
+
+        for (std::size_t k = 0; k < group.size(); ++k)
+        {
+            columns[k].score = group[k].length;
+            columns[k].best = group[k].length;
+        }
+
+        for (std::size_t i = 0; i < part.size(); ++i)
+        {
+            const auto c = static_cast<unsigned char>(part[i]);
+            const auto word_end = fuzzy_word_end(part, i);
+
+            for (std::size_t k = 0; k < group.size(); ++k)
+            {
+                columns[k].Step(group[k], c, word_end);
+            }
+        }
+
+        for (std::size_t k = 0; k < group.size(); ++k)
+        {
+            const auto& keyword = group[k];
+            const auto distance = columns[k].best;
+
+            if (distance > keyword.max_distance)
+            {
+                continue;
+            }
+
+            if (!best.type || distance < best_distance)
+            {
+                best = { keyword.type, false };
+                best_distance = distance;
+            }
+            else if (distance == best_distance && keyword.type != *best.type)
+            {
+                best.ambiguous = true;
+            }
+        }
+    }
+
+    return best;
+}
+
+// A part category as a taxonomy declares it
+struct Part_Category
+{
+    std::string name{};
+    std::size_t slots{ 0 };
+
+    // One per slot, printed as "(label): part" lines. Without labels a
+    // single slot prints after the name and several as a list
+    std::vector<std::string> labels{};
+};
+
+// Puts lines containing the rule's text in the category 'type'
+using Taxonomy_Rule = MatchDfa::Pattern;
+
+// Part categories and the rules that sort lines into them. The built-in
+// taxonomy classifies with the compile-time tables, one loaded from a file
+// is compiled at startup into a MatchDfa so classification stays one pass
+// per line for its keywords and one for its regexes, however many rules
+class Taxonomy
+{
+public:
+    // Part_Type is a byte and 0xFF marks lines that matched nothing
+    static constexpr std::size_t max_categories = 0xFF;
+
+    Taxonomy(std::vector<Part_Category> categories,
+        std::vector<Taxonomy_Rule> rules)
+        : Taxonomy(std::move(categories), std::move(rules), true, {})
+    {
+    }
+
+    // The categories of part_categories_list with the rules of
+    // part_types_list
+    static Taxonomy Builtin();
+
+    // One declaration per line, '#' starts a comment line:
+    //   category <name> <slots> [one label per slot]
+    //   keyword <category> <text>
+    //   regex <category> <pattern>
+    // Categories print in the order they are declared, rules are tried in
+    // the order they are listed
+    static Taxonomy Load(const std::filesystem::path& fname);
+
+    // The taxonomy every loader classifies with. Only swapped at startup,
+    // before any catalog is read
+    static const Taxonomy& Active() noexcept { return ActiveStorage(); }
+
+    static void Activate(Taxonomy&& taxonomy)
+    {
+        ActiveStorage() = std::move(taxonomy);
+    }
+
+    // The same taxonomy matching parts the way fold_part() writes them,
+    // whatever their case and spacing. Rule texts are folded to match
+    [[nodiscard]] Taxonomy Normalized() const
+    {
+        auto matching = _matching;
+        matching.normalize = true;
+        return Taxonomy(_categories, _rules, _dfa.has_value(), matching);
+    }
+
+    // The same taxonomy placing parts no rule matched by the keyword they
+    // are fewest edits away from, up to 'max_distance' ("wepaon" is two)
+    [[nodiscard]] Taxonomy Fuzzy(const std::size_t max_distance) const
+    {
+        auto matching = _matching;
+        matching.fuzzy_distance = max_distance;
+        return Taxonomy(_categories, _rules, _dfa.has_value(), matching);
+    }
+
+    // Same priority rules as classify_part_builtin: a trailing keyword
+    // names the part, otherwise the first rule that matches anywhere wins
+    [[nodiscard]] Part_Match Classify(
+        const std::string_view part) const noexcept
+    {
+        if (!_matching.normalize)
+        {
+            return Match(part);
+        }
+
+        // Folded on the stack, the line is in cache and the catalog bytes
+        // stay as they were for printing
+        std::array<char, 256 + fold_slack> buffer;
+
+        if (part.size() + fold_slack <= buffer.size())
+        {
+            return Match({ buffer.data(), fold_part(part, buffer.data()) });
+        }
+
+        std::string folded(part.size() + fold_slack, '\0');
+        folded.resize(fold_part(part, folded.data()));
+        return Match(folded);
+    }
+
+    [[nodiscard]] const std::vector<Part_Category>& Categories() const noexcept
+    {
+        return _categories;
+    }
+
+    [[nodiscard]] const std::vector<Taxonomy_Rule>& Rules() const noexcept
+    {
+        return _rules;
+    }
+
+    // Changes with every category and rule, so anything classified under
+    // another taxonomy can be told apart
+    [[nodiscard]] std::uint64_t Fingerprint() const noexcept
+    {
+        return _fingerprint;
+    }
+
+private:
+    // How lines are compared with the rules
+    struct Matching
+    {
+        bool normalize{ false };
+
+        // Zero only matches keywords exactly
+        std::size_t fuzzy_distance{ 0 };
+    };
+
+    Taxonomy(std::vector<Part_Category> categories,
+        std::vector<Taxonomy_Rule> rules, bool compile, Matching matching);
+
+    // Typos are only looked for once the exact rules found nothing
+    [[nodiscard]] Part_Match Match(const std::string_view part) const noexcept
+    {
+        const auto match = MatchExactly(part);
+        return match.type || _fuzzy.empty() ? match : match_fuzzy(_fuzzy, part);
+    }
+
+    [[nodiscard]] Part_Match MatchExactly(
+        const std::string_view part) const noexcept
+    {
+        if (!_dfa)
+        {
+            return classify_part_builtin(part);
+        }
+
+        const auto token = trailing_token(part);
+        const auto keyword = std::lower_bound(_tokens.begin(), _tokens.end(),
+            token, [](const auto& entry, const std::string_view value) {
+                return entry.first < value;
+            });
+
+        if (keyword != _tokens.end() && keyword->first == token)
+        {
+            return { keyword->second, false };
+        }
+
+        return _dfa->Match(part);
+    }
+
+    static Taxonomy& ActiveStorage()
+    {
+        static Taxonomy taxonomy = Builtin();
+        return taxonomy;
+    }
+
+    std::vector<Part_Category> _categories;
+    std::vector<Taxonomy_Rule> _rules;
+
+    // Single token keywords, sorted, for the trailing token check
+    std::vector<std::pair<std::string, Part_Type>> _tokens{};
+
+    // Not built for the built-in taxonomy
+    std::optional<MatchDfa> _dfa{};
+    std::uint64_t _fingerprint{ 0 };
+    Matching _matching{};
+
+    // Keyword rules prepared for fuzzy matching, when it is on
+    std::vector<Fuzzy_Keyword> _fuzzy{};
+};
+
+Taxonomy::Taxonomy(std::vector<Part_Category> categories,
+    std::vector<Taxonomy_Rule> rules, const bool compile,
+    const Matching matching)
+    : _categories(std::move(categories)), _rules(std::move(rules)),
+      _matching(matching)
+{
+    std::stringstream canonical;
+
+    if (_matching.fuzzy_distance != 0)
+    {
+        canonical << "fuzzy\t" << _matching.fuzzy_distance << '\n';
+    }
+
+    if (_matching.normalize)
+    {
+        canonical << "normalize\n";
+
+        // Keywords are folded like the lines they are looked for in,
+        // regexes only in their literal bytes
+        for (auto& rule : _rules)
+        {
+            if (rule.regex)
+            {
+                rule.text = fold_regex(rule.text);
+            }
+            else
+            {
+                std::string folded(rule.text.size() + fold_slack, '\0');
+                folded.resize(fold_part(rule.text, folded.data()));
+                rule.text = std::move(folded);
+            }
+        }
+    }
+
+    for (const auto& category : _categories)
+    {
+        canonical << "category\t" << category.name << '\t' << category.slots;
+
+        for (const auto& label : category.labels)
+        {
+            canonical << '\t' << label;
+        }
+
+        canonical << '\n';
+    }
+
+    for (const auto& rule : _rules)
+    {
+        canonical << (rule.regex ? "regex\t" : "keyword\t")
+                  << static_cast<unsigned>(rule.type) << '\t' << rule.text
+                  << '\n';
+
+        // The first rule for a keyword wins, like it does in the scan
+        const auto& text = rule.text;
+
+        if (rule.regex || text.empty()
+            || text.find_first_of(" \t") != std::string::npos)
+        {
+            continue;
+        }
+
+        const auto pos = std::lower_bound(_tokens.begin(), _tokens.end(),
+            text, [](const auto& entry, const std::string& value) {
+                return entry.first < value;
+            });
+
+        if (pos == _tokens.end() || pos->first != text)
+        {
+            _tokens.emplace(pos, text, rule.type);
+        }
+    }
+
+    for (const auto& rule : _rules)
+    {
+        if (_matching.fuzzy_distance != 0 && !rule.regex
+            && !rule.text.empty() && rule.text.size() <= max_fuzzy_keyword)
+        {
+            _fuzzy.push_back(make_fuzzy_keyword(
+                rule.text, rule.type, _matching.fuzzy_distance));
+        }
+    }
+
+    _fingerprint = hash_bytes(canonical.str());
+
+    if (compile)
+    {
+        _dfa.emplace(_rules);
+    }
+}
+
+Taxonomy Taxonomy::Builtin()
+{
+    std::vector<Part_Category> categories;
+    std::vector<Taxonomy_Rule> rules;
+
+    for (const auto& info : part_categories_list)
+    {
+        auto& category = categories.emplace_back();
+        category.name = info.name;
+        category.slots = info.slots;
+
+        std::istringstream labels(info.labels);
+
+        for (std::string label; labels >> label;)
+        {
+            category.labels.push_back(label);
+        }
+    }
+
+    for (const auto& info : part_types_list)
+    {
+        rules.push_back({ info.keyword, false, info.type });
+    }
+
+    return Taxonomy(std::move(categories), std::move(rules), false, {});
+}
+
+Taxonomy Taxonomy::Load(const std::filesystem::path& fname)
+{
+    std::ifstream file(fname);
+
+    if (!file.is_open())
+    {
+        std::stringstream err_mesg;
+        err_mesg << "file: '" << fname.string() << "' could not be opened!";
+        throw std::runtime_error(err_mesg.str());
+    }
+
+    std::vector<Part_Category> categories;
+    std::vector<Taxonomy_Rule> rules;
+    std::size_t line_number = 0;
+
+    const auto error = [&](const std::string_view reason) {
+        std::stringstream err_mesg;
+        err_mesg << "file: '" << fname.string() << "' line " << line_number
+                 << ": " << reason << '!';
+        return std::runtime_error(err_mesg.str());
+    };
+
+    const auto trim = [](std::string_view text) {
+        const auto first = text.find_first_not_of(" \t\r");
+
+        if (first == std::string_view::npos)
+        {
+            return std::string_view{};
+        }
+
+        text.remove_prefix(first);
+        return text.substr(0, text.find_last_not_of(" \t\r") + 1);
+    };
+
+    // Cuts the first word off 'text'
+    const auto next_word = [&trim](std::string_view& text) {
+        const auto word = text.substr(0, text.find_first_of(" \t"));
+        text = trim(text.substr(word.size()));
+        return word;
+    };
+
+    for (std::string text; std::getline(file, text);)
+    {
+        ++line_number;
+
+        auto line = trim(text);
+
+        if (line.empty() || line.front() == '#')
+        {
+            continue;
+        }
+
+        const auto directive = next_word(line);
+
+        if (directive == "category")
+        {
+            auto& category = categories.emplace_back();
+            category.name = next_word(line);
+
+            const auto slots = next_word(line);
+            const auto [end, result] = std::from_chars(
+                slots.data(), slots.data() + slots.size(), category.slots);
+
+            if (result != std::errc{} || end != slots.data() + slots.size()
+                || category.slots == 0)
+            {
+                throw error("a category needs a name and a slot count");
+            }
+
+            while (!line.empty())
+            {
+                category.labels.emplace_back(next_word(line));
+            }
+
+            if (!category.labels.empty()
+                && category.labels.size() != category.slots)
+            {
+                throw error("a category needs one label per slot or none");
+            }
+
+            if (categories.size() > max_categories
+                || std::count_if(categories.begin(), categories.end(),
+                       [&category](const auto& other) {
+                           return other.name == category.name;
+                       })
+                    > 1)
+            {
+                throw error("category '" + category.name + "' is a repeat");
+            }
+        }
+        else if (directive == "keyword" || directive == "regex")
+        {
+            const auto name = next_word(line);
+            const auto category = std::find_if(categories.begin(),
+                categories.end(),
+                [name](const auto& other) { return other.name == name; });
+
+            if (category == categories.end())
+            {
+                throw error("unknown category '" + std::string(name) + "'");
+            }
+
+            if (line.empty())
+            {
+                throw error("a rule needs a category and a pattern");
+            }
+
+            if (directive == "regex")
+            {
+                try
+                {
+                    MatchDfa::Validate(line);
+                }
+                catch (const std::runtime_error& ex)
+                {
+                    throw error(ex.what());
+                }
+            }
+
+            rules.push_back({ std::string(line), directive == "regex",
+                static_cast<Part_Type>(category - categories.begin()) });
+        }
+        else
+        {
+            throw error("unknown directive '" + std::string(directive) + "'");
+        }
+    }
+
+    if (categories.empty() || rules.empty())
+    {
+        std::stringstream err_mesg;
+        err_mesg << "file: '" << fname.string()
+                 << "' needs at least one category and one rule!";
+        throw std::runtime_error(err_mesg.str());
+    }
+
+    return Taxonomy(std::move(categories), std::move(rules));
+}
+
+// The first category of the active taxonomy a part belongs to, so every part
+// lands in at most one category
+inline Part_Match classify_part(
+    const std::string_view part) noexcept
+{
+    return Taxonomy::Active().Classify(part);
+}
+
+// Persistent map from line hashes to what the active taxonomy made of them.
+// Nightly catalogs mostly repeat yesterday's lines, so a reload through the
+// cache hashes each line and only scans the few it has not seen before. The
+// file is an open-addressing table mapped as is, one 64-bit slot per entry
+class ClassificationCache
+{
+public:
+    static constexpr std::array<char, 8> magic{ 'S', 'H', 'I', 'P', 'C', 'L',
+        'S', '\0' };
+    static constexpr std::uint32_t version = 1;
+
+    // Starts empty when 'fname' does not exist yet, or was written by
+    // another version or under another taxonomy, the next Update() replaces
+    // it. A file that is not a cache at all is refused
+    explicit ClassificationCache(std::filesystem::path fname);
+
+    // Consulted by the catalog loaders when set. Only swapped at startup,
+    // after the taxonomy
+    static const ClassificationCache* Active() noexcept
+    {
+        const auto& cache = ActiveStorage();
+        return cache ? &*cache : nullptr;
+    }
+
+    static void Activate(const std::filesystem::path& fname)
+    {
+        ActiveStorage().emplace(fname);
+    }
+
+    // Classifies 'lines', whose hash_bytes() are 'hashes', through the
+    // cache and calls fn(index, match) for each one in order
+    template<typename Fn>
+    void Classify(const std::span<const std::string_view> lines,
+        const std::span<const std::uint64_t> hashes, Fn&& fn) const
+    {
+        _misses.fetch_add(
+            Resolve(lines, hashes, fn), std::memory_order_relaxed);
+    }
+
+    // Lines the loads so far had to classify
+    [[nodiscard]] std::size_t MissCount() const noexcept
+    {
+        return _misses.load(std::memory_order_relaxed);
+    }
+
+    // Rewrites the file with exactly the entries for 'lines', dropping the
+    // ones no longer in the catalog. Nothing is written when every load hit,
+    // returns how many entries were written
+    std::size_t Update(std::span<const std::string_view> lines) const;
+
+private:
+    struct Cache_Header
+    {
+        std::array<char, 8> magic;
+        std::uint32_t version;
+        std::uint32_t reserved;
+        std::uint64_t taxonomy;
+
+        // A power of two, the slots follow the header
+        std::uint64_t slot_count;
+    };
+
+    // A slot holds the hash bits above bit 9 as its tag, bit 9 set so no
+    // entry is zero, bit 8 for ambiguous and the type in the low byte.
+    // Hashes that differ only in their low 9 bits share a tag once a probe
+    // runs past their home slot, at 55 tag bits that is left to chance
+    static constexpr std::uint64_t value_bits = 0x1FF;
+    static constexpr std::uint64_t occupied_bit = 0x200;
+    static constexpr std::uint64_t no_type = Taxonomy::max_categories;
+
+    static constexpr std::uint64_t Key(const std::uint64_t hash) noexcept
+    {
+        return (hash & ~(value_bits | occupied_bit)) | occupied_bit;
+    }
+
+    static std::optional<ClassificationCache>& ActiveStorage()
+    {
+        static std::optional<ClassificationCache> cache;
+        return cache;
+    }
+
+    [[nodiscard]] const std::uint64_t* Slot(
+        const std::uint64_t hash) const noexcept
+    {
+        return _slots.data() + (hash & _mask);
+    }
+
+    // Classify without counting the misses, returns how many there were
+    template<typename Fn>
+    std::size_t Resolve(const std::span<const std::string_view> lines,
+        const std::span<const std::uint64_t> hashes, Fn&& fn) const
+    {
+        // Far enough ahead to hide a cache miss behind the lookups between
+        constexpr std::size_t prefetch_distance = 8;
+
+        std::size_t misses = 0;
+
+        for (std::size_t i = 0; i < lines.size(); ++i)
+        {
+            if (i + prefetch_distance < hashes.size())
+            {
+                __builtin_prefetch(Slot(hashes[i + prefetch_distance]));
+            }
+
+            auto match = Lookup(hashes[i]);
+
+            if (!match)
+            {
+                match = classify_part(lines[i]);
+                ++misses;
+            }
+
+            fn(i, *match);
+        }
+
+        return misses;
+    }
+
+    [[nodiscard]] std::optional<Part_Match> Lookup(
+        const std::uint64_t hash) const noexcept
+    {
+        if (_slots.empty())
+        {
+            return std::nullopt;
+        }
+
+        const auto key = Key(hash);
+
+        for (auto index = hash & _mask; _slots[index] != 0;
+             index = (index + 1) & _mask)
+        {
+            const auto slot = _slots[index];
+
+            if ((slot & ~value_bits) == key)
+            {
+                const auto type = slot & 0xFFU;
+                return Part_Match{ type == no_type
+                        ? std::nullopt
+                        : std::optional(static_cast<Part_Type>(type)),
+                    (slot & 0x100U) != 0 };
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    std::filesystem::path _fname;
+    MappedFile _mapping{};
+    std::span<const std::uint64_t> _slots{};
+    std::uint64_t _mask{ 0 };
+    mutable std::atomic<std::size_t> _misses{ 0 };
+};
+
+ClassificationCache::ClassificationCache(std::filesystem::path fname)
+    : _fname(std::move(fname))
+{
+    const FileDescriptor file(::open(_fname.c_str(), O_RDONLY | O_CLOEXEC));
+
+    if (file.Get() < 0)
+    {
+        return;
+    }
+
+    auto mapping = MappedFile::Map(file.Get());
+    const auto bytes = mapping.Bytes();
+    Cache_Header header{};
+
+    if (bytes.size() >= sizeof(header.magic))
+    {
+        std::memcpy(&header.magic, bytes.data(), sizeof(header.magic));
+    }
+
+    if (header.magic != magic)
+    {
+        std::stringstream err_mesg;
+        err_mesg << "file: '" << _fname.string()
+                 << "' is not a classification cache!";
+        throw std::runtime_error(err_mesg.str());
+    }
+
+    if (bytes.size() < sizeof(header))
+    {
+        return;
+    }
+
+    std::memcpy(&header, bytes.data(), sizeof(header));
+
+    // Anything stale is simply rebuilt, that is all a cache owes its users
+    if (header.version != version
+        || header.taxonomy != Taxonomy::Active().Fingerprint()
+        || !std::has_single_bit(header.slot_count)
+        || header.slot_count
+            != (bytes.size() - sizeof(header)) / sizeof(std::uint64_t)
+        || (bytes.size() - sizeof(header)) % sizeof(std::uint64_t) != 0)
+    {
+        return;
+    }
+
+    // Every lookup lands somewhere different
+    mapping.Advise(MADV_RANDOM);
+
+    _slots = { reinterpret_cast<const std::uint64_t*>(
+                   bytes.data() + sizeof(header)),
+        static_cast<std::size_t>(header.slot_count) };
+    _mask = header.slot_count - 1;
+    _mapping = std::move(mapping);
+}
+
+std::size_t ClassificationCache::Update(
+    const std::span<const std::string_view> lines) const
+{
+    if (MissCount() == 0)
+    {
+        return 0;
+    }
+
+    // At most half full keeps probe runs short
+    const auto slot_count =
+        std::bit_ceil(std::max<std::size_t>(lines.size() * 2, 16));
+    const auto mask = slot_count - 1;
+
+    std::vector<std::uint64_t> slots(slot_count);
+    std::vector<std::uint64_t> hashes(lines.size());
+    std::size_t entries = 0;
+
+    std::ranges::transform(lines, hashes.begin(), hash_bytes);
+
+    // Misses are classified a second time here, they are the few lines that
+    // changed since the last run, and already counted by the load
+    Resolve(lines, hashes, [&](const std::size_t i, const Part_Match& match) {
+        const auto key = Key(hashes[i]);
+        auto index = hashes[i] & mask;
+
+        for (; slots[index] != 0; index = (index + 1) & mask)
+        {
+            if ((slots[index] & ~value_bits) == key)
+            {
+                return;
+            }
+        }
+
+        const auto type =
+            match.type ? static_cast<std::uint64_t>(*match.type) : no_type;
+
+        slots[index] = key | (match.ambiguous ? 0x100U : 0U) | type;
+        ++entries;
+    });
+
+    const Cache_Header header{ magic, version, 0,
+        Taxonomy::Active().Fingerprint(), slot_count };
+
+    // Written beside the cache and renamed over it, the old table stays
+    // mapped and valid until this process exits
+    auto temp_name = _fname;
+    temp_name += ".tmp";
+
+    std::ofstream file(temp_name, std::ios::binary | std::ios::trunc);
+
+    if (!file.is_open())
+    {
+        std::stringstream err_mesg;
+        err_mesg << "file: '" << temp_name.string() << "' could not be opened!";
+        throw std::runtime_error(err_mesg.str());
+    }
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(slots.data()),
+        static_cast<std::streamsize>(sizeof(std::uint64_t) * slot_count));
+    file.close();
+
+    if (!file)
+    {
+        std::stringstream err_mesg;
+        err_mesg << "file: '" << temp_name.string()
+                 << "' could not be written!";
+        throw std::runtime_error(err_mesg.str());
+    }
+
+    std::filesystem::rename(temp_name, _fname);
+    return entries;
+}
+
+// Open-addressing set of line views, used to drop duplicate lines without
+// sorting and without one allocation per entry
+class LineSet
+{
+public:
+    explicit LineSet(const std::size_t expected)
+        : _slots(std::bit_ceil(std::max<std::size_t>(16, expected * 2)))
+    {
+    }
+
+    // True when 'line' was not in the set yet
+    bool Insert(const std::string_view line, const std::uint64_t hash)
+    {
+        // Keep the load factor at or below one half
+        if ((_size + 1) * 2 > _slots.size())
+        {
+            Grow();
+        }
+
+        const auto mask = _slots.size() - 1;
+
+        for (auto index = hash & mask;; index = (index + 1) & mask)
+        {
+            auto& slot = _slots[index];
+
+            // Line views always point into a catalog buffer, so a null view
+            // marks a free slot
+            if (slot.line.data() == nullptr)
+            {
+                slot = { hash, line };
+                ++_size;
+                return true;
+            }
+
+            if (slot.hash == hash && slot.line == line)
+            {
+                return false;
+            }
+        }
+    }
+
+private:
+    struct Slot
+    {
+        std::uint64_t hash{ 0 };
+        std::string_view line{};
+    };
+
+    void Grow()
+    {
+        std::vector<Slot> old(_slots.size() * 2);
+        std::swap(old, _slots);
+        _size = 0;
+
+        for (const auto& slot : old)
+        {
+            if (slot.line.data() != nullptr)
+            {
+                Insert(slot.line, slot.hash);
+            }
+        }
+    }
+
+    std::vector<Slot> _slots;
+    std::size_t _size{ 0 };
+};
+
+// Parts grouped by type, every group in catalog order. Classifying happens
+// once when a catalog is loaded, after that a ship only costs its slots
+class PartCatalog
+{
+public:
+    // Groups are made as parts arrive, the taxonomy decides how many
+    void Add(const Part_Type type, const std::string_view part)
+    {
+        const auto index = static_cast<std::size_t>(type);
+
+        if (index >= _buckets.size())
+        {
+            _buckets.resize(index + 1);
+        }
+
+        _buckets[index].push_back(part);
+    }
+
+    // A line that matched several categories, settled by rule priority
+    void CountAmbiguous() noexcept { ++_ambiguous; }
+
+    // Appends every group of 'other' after the matching group here
+    void Append(const PartCatalog& other)
+    {
+        _ambiguous += other._ambiguous;
+        _buckets.resize(std::max(_buckets.size(), other._buckets.size()));
+
+        for (std::size_t i = 0; i < other._buckets.size(); ++i)
+        {
+            _buckets[i].insert(_buckets[i].end(), other._buckets[i].begin(),
+                other._buckets[i].end());
+        }
+    }
+
+    [[nodiscard]] std::size_t Count(const Part_Type type) const noexcept
+    {
+        const auto index = static_cast<std::size_t>(type);
+        return index < _buckets.size() ? _buckets[index].size() : 0;
+    }
+
+    [[nodiscard]] std::string_view Part(
+        const Part_Type type, const std::size_t index) const noexcept
+    {
+        return _buckets[static_cast<std::size_t>(type)][index];
+    }
+
+    [[nodiscard]] std::size_t AmbiguousCount() const noexcept
+    {
+        return _ambiguous;
+    }
+
+private:
+    std::vector<std::vector<std::string_view>> _buckets{};
+    std::size_t _ambiguous{ 0 };
+};
+
+// Every part of a catalog under a dense id, so ships carry integers and
+// only turn them back into strings when printed. The parts of each type sit
+// in one array range, looking a part up by id is one index
+class PartIndex
+{
+public:
+    PartIndex() = default;
+
+    // Copies the views of 'source' in type order, the bytes behind them
+    // must outlive the index
+    template<PartSource Source>
+    PartIndex(const Source& source, std::size_t type_count);
+
+    [[nodiscard]] std::size_t Count(const Part_Type type) const noexcept
+    {
+        const auto index = static_cast<std::size_t>(type);
+        return index + 1 < _first.size() ? _first[index + 1] - _first[index]
+                                         : 0;
+    }
+
+    [[nodiscard]] std::string_view Part(
+        const Part_Type type, const std::size_t index) const noexcept
+    {
+        return _parts[FirstId(type) + index];
+    }
+
+    [[nodiscard]] Part_Id FirstId(const Part_Type type) const noexcept
+    {
+        return _first[static_cast<std::size_t>(type)];
+    }
+
+    [[nodiscard]] std::string_view Part(const Part_Id id) const noexcept
+    {
+        return _parts[id];
+    }
+
+private:
+    // First id of every type, plus one past the last part
+    std::vector<Part_Id> _first{};
+    std::vector<std::string_view> _parts{};
+};
+
+template<PartSource Source>
+PartIndex::PartIndex(const Source& source, const std::size_t type_count)
+    : _first(type_count + 1)
+{
+    for (std::size_t i = 0; i < type_count; ++i)
+    {
+        const auto type = static_cast<Part_Type>(i);
+        const auto count = source.Count(type);
+
+        if (count > std::numeric_limits<Part_Id>::max() - _parts.size())
+        {
+            throw std::runtime_error("catalog has more parts than part ids");
+        }
+
+        _first[i] = static_cast<Part_Id>(_parts.size());
+
+        for (std::size_t j = 0; j < count; ++j)
+        {
+            _parts.push_back(source.Part(type, j));
+        }
+    }
+
+    _first[type_count] = static_cast<Part_Id>(_parts.size());
+}
+
+// Classifies lines one after another into buckets, through the
+// classification cache when there is one
+void classify_lines(
+    const std::span<const std::string_view> lines, PartCatalog& buckets)
+{
+    const auto add = [&buckets](
+                         const std::string_view line, const Part_Match& match) {
+        if (match.type)
+        {
+            buckets.Add(*match.type, line);
+        }
+
+        if (match.ambiguous)
+        {
+            buckets.CountAmbiguous();
+        }
+    };
+
+    const auto* const cache = ClassificationCache::Active();
+
+    if (cache == nullptr)
+    {
+        for (const auto line : lines)
+        {
+            add(line, classify_part(line));
+        }
+
+        return;
+    }
+
+    // Hashed a batch at a time, so lookups are prefetched ahead without
+    // holding a hash for every line
+    constexpr std::size_t batch_size = 256;
+    std::array<std::uint64_t, batch_size> hashes{};
+
+    for (std::size_t first = 0; first < lines.size(); first += batch_size)
+    {
+        const auto batch =
+            lines.subspan(first, std::min(batch_size, lines.size() - first));
+
+        std::ranges::transform(batch, hashes.begin(), hash_bytes);
+        cache->Classify(batch, std::span(hashes).first(batch.size()),
+            [&](const std::size_t i, const Part_Match& match) {
+                add(batch[i], match);
+            });
+    }
+}
+
+// Splits and classifies 'bytes' with one task per newline-aligned chunk. The
+// per-chunk results are merged in chunk order, so 'lines' and 'buckets' end
+// up exactly as a sequential split_lines + classify_lines pass leaves them
+void parse_catalog_parallel(const std::string_view bytes, const unsigned tasks,
+    std::vector<std::string_view>& lines, PartCatalog& buckets)
+{
+    struct Chunk_Result
+    {
+        std::vector<std::string_view> lines{};
+        PartCatalog buckets{};
+    };
+
+    std::vector<std::future<Chunk_Result>> results;
+    std::size_t chunk_begin = 0;
+
+    for (unsigned i = 1; i <= tasks && chunk_begin < bytes.size(); ++i)
+    {
+        // Move each cut forward to just past a '\n', the last chunk takes
+        // whatever is left
+        auto chunk_end = bytes.size();
+
+        if (i < tasks)
+        {
+            const auto cut = std::max<std::size_t>(
+                chunk_begin, bytes.size() / tasks * i);
+            const auto newline = bytes.find('\n', cut);
+
+            chunk_end =
+                newline == std::string_view::npos ? bytes.size() : newline + 1;
+        }
+
+        const auto chunk =
+            bytes.substr(chunk_begin, chunk_end - chunk_begin);
+
+        results.push_back(std::async(std::launch::async, [chunk] {
+            Chunk_Result result;
+            result.lines.reserve(chunk.size() / 32);
+
+            split_lines(chunk, result.lines);
+            classify_lines(result.lines, result.buckets);
+            return result;
+        }));
+
+        chunk_begin = chunk_end;
+    }
+
+    for (auto& future : results)
+    {
+        // get() rethrows whatever a task threw
+        const auto result = future.get();
+
+        lines.insert(lines.end(), result.lines.begin(), result.lines.end());
+        buckets.Append(result.buckets);
+    }
+}
+
+enum class Compression : uint8_t
+{
+    None,
+    Gzip,
+    Zstd
+};
+
+// Recognises compressed catalogs by their magic bytes. Only works on
+// seekable files, a pipe cannot be peeked at without consuming it
+Compression sniff_compression(const int fd) noexcept
+{
+    std::array<unsigned char, 4> head{};
+
+    if (::pread(fd, head.data(), head.size(), 0)
+        != static_cast<ssize_t>(head.size()))
+    {
+        return Compression::None;
+    }
+
+    if (head[0] == 0x1F && head[1] == 0x8B)
+    {
+        return Compression::Gzip;
+    }
+
+    if (head == std::array<unsigned char, 4>{ 0x28, 0xB5, 0x2F, 0xFD })
+    {
+        return Compression::Zstd;
+    }
+
+    return Compression::None;
+}
+
+// A 'gzip -dc' or 'zstd -dc' child reading a compressed file and writing the
+// plain bytes into a pipe. Decompression runs on its own core and overlaps
+// with whatever the reader does with the output, with no temporary file
+class Decompressor
+{
+public:
+    ~Decompressor() noexcept
+    {
+        // Abandoned early (the reader threw), don't leave a zombie behind
+        if (_pid > 0)
+        {
+            ::kill(_pid, SIGTERM);
+            ::waitpid(_pid, nullptr, 0);
+        }
+    }
+
+    Decompressor(const Decompressor& other) = delete;
+    Decompressor& operator=(const Decompressor& other) = delete;
+
+    Decompressor(Decompressor&& other) noexcept
+        : _pid(std::exchange(other._pid, -1)), _output(std::move(other._output))
+    {
+    }
+
+    Decompressor& operator=(Decompressor&& other) noexcept
+    {
+        std::swap(_pid, other._pid);
+        std::swap(_output, other._output);
+        return *this;
+    }
+
+    static Decompressor Spawn(int input, Compression compression,
+        const std::filesystem::path& fname);
+
+    [[nodiscard]] int Output() const noexcept { return _output.Get(); }
+
+    // Reaps the child, throws when it did not exit cleanly
+    void Wait(const std::filesystem::path& fname);
+
+private:
+    Decompressor(const pid_t pid, FileDescriptor&& output) noexcept
+        : _pid(pid), _output(std::move(output))
+    {
+    }
+
+    pid_t _pid;
+    FileDescriptor _output;
+};
+
+Decompressor Decompressor::Spawn(const int input, const Compression compression,
+    const std::filesystem::path& fname)
+{
+    std::array<int, 2> pipe_fds{};
+
+    if (::pipe2(pipe_fds.data(), O_CLOEXEC) != 0)
+    {
+        throw std::runtime_error("could not create a pipe for decompression");
+    }
+
+    FileDescriptor output(pipe_fds[0]);
+    const FileDescriptor input_end(pipe_fds[1]);
+
+    // dup2 clears close-on-exec on the copies the child gets
+    posix_spawn_file_actions_t actions;
+    ::posix_spawn_file_actions_init(&actions);
+    ::posix_spawn_file_actions_adddup2(&actions, input, STDIN_FILENO);
+    ::posix_spawn_file_actions_adddup2(
+        &actions, input_end.Get(), STDOUT_FILENO);
+
+    const char* const tool = compression == Compression::Gzip ? "gzip" : "zstd";
+    std::array<char*, 4> args{ const_cast<char*>(tool),
+        const_cast<char*>("-dc"), const_cast<char*>("-q"), nullptr };
+
+    pid_t pid = -1;
+    const auto result = ::posix_spawnp(
+        &pid, tool, &actions, nullptr, args.data(), environ);
+
+    ::posix_spawn_file_actions_destroy(&actions);
+
+    if (result != 0)
+    {
+        std::stringstream err_mesg;
+        err_mesg << "file: '" << fname.string() << "' needs '" << tool
+                 << "' to be decompressed, it could not be started!";
+        throw std::runtime_error(err_mesg.str());
+    }
+
+    return Decompressor(pid, std::move(output));
+}
+
+void Decompressor::Wait(const std::filesystem::path& fname)
+{
+    int status = 0;
+
+    while (::waitpid(_pid, &status, 0) < 0 && errno == EINTR)
+    {
+    }
+
+    _pid = -1;
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        std::stringstream err_mesg;
+        err_mesg << "file: '" << fname.string()
+                 << "' could not be decompressed!";
+        throw std::runtime_error(err_mesg.str());
+    }
+}
+
+// Owns the raw bytes of a parts catalog, either as a read-only memory mapping
+// or (for pipes, compressed files and anything else mmap refuses) as heap
+// blocks, and indexes them into line spans with a single scan
+class Catalog
+{
+public:
+    ~Catalog() = default;
+
+    Catalog() = delete;
+
+    // Line views point into the owned storage, so copying is not allowed
+    Catalog(const Catalog& other) = delete;
+    Catalog& operator=(const Catalog& other) = delete;
+
+    // Moving keeps the views valid: neither the mapping nor the vector's heap
+    // block changes address
+    Catalog(Catalog&& other) = default;
+    Catalog& operator=(Catalog&& other) = default;
+
+    // Maps regular files, falls back to read() for pipes and special files.
+    // gzip and zstd files are decompressed on the fly
+    static Catalog Load(const std::filesystem::path& fname);
+
+    // Reads several regular files concurrently (io_uring, or a pread thread
+    // pool without it) into one buffer, each file is split and classified
+    // as soon as its bytes are in. Lines and buckets follow argument order,
+    // repeated lines only count once
+    static Catalog LoadMany(std::span<const std::filesystem::path> fnames);
+
+    [[nodiscard]] const std::vector<std::string_view>& Lines() const noexcept
+    {
+        return _lines;
+    }
+
+    // Every line classified by type and numbered, done while loading
+    [[nodiscard]] const PartIndex& Parts() const noexcept { return _index; }
+
+    // Lines that matched several categories, settled by rule priority
+    [[nodiscard]] std::size_t AmbiguousCount() const noexcept
+    {
+        return _ambiguous;
+    }
+
+    // Lines dropped as repeats while merging several files
+    [[nodiscard]] std::size_t DuplicateCount() const noexcept
+    {
+        return _duplicates;
+    }
+
+private:
+    // Smaller catalogs parse faster on one thread than it takes to start
+    // the others
+    static constexpr std::size_t parallel_threshold = 64U << 20U;
+
+    Catalog(MappedFile&& mapping, std::vector<char>&& buffer) noexcept
+        : _mapping(std::move(mapping)), _buffer(std::move(buffer))
+    {
+    }
+
+    void IndexLines();
+
+    // Numbers the classified parts once loading is done
+    void IndexParts();
+
+    // Reads 'fd' to the end, classifying lines as soon as they are complete
+    void ReadStream(int fd, const std::filesystem::path& fname);
+
+    MappedFile _mapping{};
+    std::vector<char> _buffer{};
+
+    // Stream storage, a line never straddles two blocks
+    std::vector<std::unique_ptr<char[]>> _blocks{};
+
+    // Compressed members of a merged catalog, decompressed separately
+    std::vector<Catalog> _merged{};
+
+    std::vector<std::string_view> _lines{};
+
+    // Filled while loading, then replaced by the index
+    PartCatalog _parts{};
+    PartIndex _index{};
+    std::size_t _ambiguous{ 0 };
+    std::size_t _duplicates{ 0 };
+};
+
+Catalog Catalog::Load(const std::filesystem::path& fname)
+{
+    const auto file = open_catalog(fname);
+    const int fd = file.Get();
+
+    Catalog catalog({}, {});
+
+    // Compressed bytes go through the decompressor, never into the mapping
+    if (const auto compression = sniff_compression(fd);
+        compression != Compression::None)
+    {
+        auto decompressor = Decompressor::Spawn(fd, compression, fname);
+
+        catalog.ReadStream(decompressor.Output(), fname);
+        decompressor.Wait(fname);
+        catalog.IndexParts();
+        return catalog;
+    }
+
+    if (auto mapping = MappedFile::Map(fd); mapping.IsMapped())
+    {
+        mapping.Advise(MADV_SEQUENTIAL);
+
+        catalog._mapping = std::move(mapping);
+        catalog.IndexLines();
+        catalog.IndexParts();
+        return catalog;
+    }
+
+    // Fallback: read the descriptor block by block
+    catalog.ReadStream(fd, fname);
+    catalog.IndexParts();
+    return catalog;
+}
+
+void Catalog::ReadStream(const int fd, const std::filesystem::path& fname)
+{
+    constexpr std::size_t block_size = 4U << 20U;
+
+    char* block = nullptr;
+    std::size_t capacity = 0;
+    std::size_t used = 0;
+
+    // Start of the first line in the block that is not complete yet
+    std::size_t line_start = 0;
+
+    // Splits and classifies [line_start, end) of the current block
+    const auto take_lines = [&](const std::size_t end) {
+        const auto first = _lines.size();
+
+        split_lines({ block + line_start, end - line_start }, _lines);
+        classify_lines(std::span(_lines).subspan(first), _parts);
+        line_start = end;
+    };
+
+    while (true)
+    {
+        if (used == capacity)
+        {
+            // Carry the unfinished line over to a fresh block, growing it
+            // for lines longer than a block
+            const auto carry = used - line_start;
+            const auto next_capacity = std::max(block_size, carry * 2);
+            auto next = std::make_unique<char[]>(next_capacity);
+
+            std::memcpy(next.get(), block + line_start, carry);
+
+            // A block that never finished a line holds no views, drop it
+            if (line_start == 0 && !_blocks.empty())
+            {
+                _blocks.pop_back();
+            }
+
+            capacity = next_capacity;
+            block = next.get();
+            used = carry;
+            line_start = 0;
+            _blocks.push_back(std::move(next));
+        }
+
+        const auto count = read_some(fd, block + used, capacity - used, fname);
+
+        if (count == 0)
+        {
+            break;
+        }
+
+        // Only the lines completed by this read are split
+        const auto* const last_newline = static_cast<const char*>(
+            ::memrchr(block + used, '\n', count));
+        used += count;
+
+        if (last_newline != nullptr)
+        {
+            take_lines(static_cast<std::size_t>(last_newline - block) + 1);
+        }
+    }
+
+    // Same as std::getline, a final line without '\n' still counts
+    if (line_start != used)
+    {
+        take_lines(used);
+    }
+}
+
+Catalog Catalog::LoadMany(const std::span<const std::filesystem::path> fnames)
+{
+    std::vector<Pending_File> files;
+    std::vector<bool> compressed;
+    std::size_t total_size = 0;
+
+    for (const auto& fname : fnames)
+    {
+        auto file = open_catalog(fname);
+
+        struct stat info
+        {
+        };
+
+        if (::fstat(file.Get(), &info) != 0 || !S_ISREG(info.st_mode))
+        {
+            std::stringstream err_mesg;
+            err_mesg << "file: '" << fname.string()
+                     << "' is not a regular file, only one stream can be read "
+                        "at a time!";
+            throw std::runtime_error(err_mesg.str());
+        }
+
+        // Compressed files are not read here, they are decompressed on a
+        // thread of their own
+        const auto is_compressed =
+            sniff_compression(file.Get()) != Compression::None;
+        const auto size =
+            is_compressed ? 0 : static_cast<std::size_t>(info.st_size);
+
+        compressed.push_back(is_compressed);
+        files.push_back({ fname, std::move(file), nullptr, size });
+        total_size += size;
+    }
+
+    Catalog catalog({}, std::vector<char>(total_size));
+    char* dest = catalog._buffer.data();
+
+    for (auto& file : files)
+    {
+        file.dest = dest;
+        dest += file.size;
+    }
+
+    // Per file: its lines, their hashes, their types (none when no keyword
+    // matched) and which were ambiguous, all worked out while other files
+    // are still loading
+    constexpr auto no_type =
+        static_cast<std::uint8_t>(Taxonomy::max_categories);
+
+    std::vector<std::vector<std::string_view>> file_lines(files.size());
+    std::vector<std::vector<std::uint64_t>> file_hashes(files.size());
+    std::vector<std::vector<std::uint8_t>> file_types(files.size());
+    std::vector<std::vector<bool>> file_ambiguous(files.size());
+
+    // Hashes and classifies the lines of file 'i', each file's results
+    // are its own so files can be handled on different threads
+    const auto classify_file = [&](const std::size_t i) {
+        const auto& lines = file_lines[i];
+        auto& hashes = file_hashes[i];
+
+        hashes.resize(lines.size());
+        file_types[i].reserve(lines.size());
+        file_ambiguous[i].reserve(lines.size());
+
+        std::ranges::transform(lines, hashes.begin(), hash_bytes);
+
+        const auto add = [&](const std::size_t, const Part_Match& match) {
+            file_types[i].push_back(
+                match.type ? static_cast<std::uint8_t>(*match.type) : no_type);
+            file_ambiguous[i].push_back(match.ambiguous);
+        };
+
+        // The hashes are needed for dropping duplicates anyway
+        if (const auto* const cache = ClassificationCache::Active())
+        {
+            cache->Classify(lines, hashes, add);
+            return;
+        }
+
+        for (std::size_t j = 0; j < lines.size(); ++j)
+        {
+            add(j, classify_part(lines[j]));
+        }
+    };
+
+    // Compressed members are decompressed one after another on their own
+    // thread, which alone touches _merged, so they never hold up the reads
+    std::future<void> decompressing;
+
+    if (std::ranges::find(compressed, true) != compressed.end())
+    {
+        decompressing = std::async(std::launch::async, [&] {
+            for (std::size_t i = 0; i < files.size(); ++i)
+            {
+                if (compressed[i])
+                {
+                    const auto& member =
+                        catalog._merged.emplace_back(Load(files[i].name));
+                    file_lines[i] = member.Lines();
+                    classify_file(i);
+                }
+            }
+        });
+    }
+
+    // Runs on this thread while the other files are still being read
+    const auto on_file = [&](const std::size_t i) {
+        if (compressed[i])
+        {
+            return;
+        }
+
+        split_lines({ files[i].dest, files[i].size }, file_lines[i]);
+        classify_file(i);
+    };
+
+    if (!read_files_uring(files, on_file))
+    {
+        read_files_pooled(files, on_file);
+    }
+
+    // Rethrows whatever the decompression ran into
+    if (decompressing.valid())
+    {
+        decompressing.get();
+    }
+
+    // Merging in argument order keeps the first copy of every line, so the
+    // result does not depend on which read finished first
+    std::size_t line_count = 0;
+
+    for (const auto& lines : file_lines)
+    {
+        line_count += lines.size();
+    }
+
+    LineSet seen(line_count);
+    catalog._lines.reserve(line_count);
+
+    for (std::size_t i = 0; i < files.size(); ++i)
+    {
+        for (std::size_t j = 0; j < file_lines[i].size(); ++j)
+        {
+            const auto line = file_lines[i][j];
+
+            if (!seen.Insert(line, file_hashes[i][j]))
+            {
+                ++catalog._duplicates;
+                continue;
+            }
+
+            catalog._lines.push_back(line);
+
+            if (file_types[i][j] != no_type)
+            {
+                catalog._parts.Add(
+                    static_cast<Part_Type>(file_types[i][j]), line);
+            }
+
+            if (file_ambiguous[i][j])
+            {
+                catalog._parts.CountAmbiguous();
+            }
+        }
+    }
+
+    catalog.IndexParts();
+    return catalog;
+}
+
+void Catalog::IndexParts()
+{
+    _ambiguous = _parts.AmbiguousCount();
+    _index = PartIndex(_parts, Taxonomy::Active().Categories().size());
+    _parts = {};
+}
+
+void Catalog::IndexLines()
+{
+    const auto bytes = _mapping.Bytes();
+
+    // Rough guess of the line count, saves most of the regrowth on big files
+    _lines.reserve(bytes.size() / 32);
+
+    const auto threads = std::thread::hardware_concurrency();
+
+    // Big catalogs are split and classified on every core at once
+    if (bytes.size() >= parallel_threshold && threads > 1)
+    {
+        parse_catalog_parallel(bytes, threads, _lines, _parts);
+        return;
+    }
+
+    // One vectorized pass over the bytes, then one over the lines
+    split_lines(bytes, _lines);
+    classify_lines(_lines, _parts);
+}
+
+// Spreads a 64-bit seed over engine state, consecutive seeds give unrelated
+// states. Each call advances 'state'
+constexpr std::uint64_t splitmix64(std::uint64_t& state) noexcept
+{
+    auto z = state += 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30U)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27U)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31U);
+}
+
+// xoshiro256** by Blackman and Vigna: 32 bytes of state, a handful of
+// shifts and xors per 64-bit output, against mt19937's 5 KB
+class Xoshiro256StarStar
+{
+public:
+    using result_type = std::uint64_t;
+
+    explicit constexpr Xoshiro256StarStar(std::uint64_t seed) noexcept
+    {
+        for (auto& word : _state)
+        {
+            word = splitmix64(seed);
+        }
+    }
+
+    // Exactly this state, for checking against the reference outputs
+    explicit constexpr Xoshiro256StarStar(
+        const std::array<std::uint64_t, 4>& state) noexcept
+        : _state(state)
+    {
+    }
+
+    static constexpr result_type min() noexcept { return 0; }
+
+    static constexpr result_type max() noexcept
+    {
+        return std::numeric_limits<result_type>::max();
+    }
+
+    constexpr result_type operator()() noexcept
+    {
+        const auto result = std::rotl(_state[1] * 5, 7) * 9;
+        const auto shifted = _state[1] << 17U;
+
+        _state[2] ^= _state[0];
+        _state[3] ^= _state[1];
+        _state[1] ^= _state[2];
+        _state[0] ^= _state[3];
+        _state[2] ^= shifted;
+        _state[3] = std::rotl(_state[3], 45);
+        return result;
+    }
+
+private:
+    std::array<std::uint64_t, 4> _state{};
+};
+
+static_assert(Xoshiro256StarStar({ 1, 2, 3, 4 })() == 11520);
+
+// PCG64 (XSL RR 128/64) by O'Neill: a 128-bit LCG whose high and low halves
+// are folded and rotated into each output
+class Pcg64
+{
+public:
+    using result_type = std::uint64_t;
+
+    explicit constexpr Pcg64(std::uint64_t seed) noexcept
+    {
+        const auto word = [&seed] {
+            return static_cast<Wide>(splitmix64(seed));
+        };
+
+        const auto state = word() << 64U | word();
+        const auto stream = word() << 64U | word();
+
+        // pcg_setseq_128_srandom_r
+        _increment = stream << 1U | 1U;
+        Step();
+        _state += state;
+        Step();
+    }
+
+    static constexpr result_type min() noexcept { return 0; }
+
+    static constexpr result_type max() noexcept
+    {
+        return std::numeric_limits<result_type>::max();
+    }
+
+    constexpr result_type operator()() noexcept
+    {
+        Step();
+
+        const auto folded = static_cast<std::uint64_t>(_state >> 64U)
+            ^ static_cast<std::uint64_t>(_state);
+        return std::rotr(folded, static_cast<int>(_state >> 122U));
+    }
+
+private:
+    __extension__ using Wide = unsigned __int128;
+
+    static constexpr Wide multiplier =
+        static_cast<Wide>(0x2360ED051FC65DA4ULL) << 64U
+        | 0x4385DF649FCCF645ULL;
+
+    constexpr void Step() noexcept
+    {
+        _state = _state * multiplier + _increment;
+    }
+
+    Wide _state{ 0 };
+    Wide _increment{ 0 };
+};
+
+// Philox4x32-10 by Salmon et al., counter based: every 128-bit block is ten
+// multiply-xor rounds of (counter, key) with no state carried between
+// blocks. The key is the seed and the counter holds the ship index and the
+// block number within the ship, so ship i's draws are a pure function of
+// (seed, i) and any ship can be built first, on any thread, in any order
+class Philox4x32
+{
+public:
+    using result_type = std::uint64_t;
+    using Block = std::array<std::uint32_t, 4>;
+    using Key = std::array<std::uint32_t, 2>;
+
+    constexpr Philox4x32(
+        const std::uint64_t seed, const std::uint64_t ship = 0) noexcept
+        : _key{ static_cast<std::uint32_t>(seed),
+            static_cast<std::uint32_t>(seed >> 32U) }
+    {
+        Seek(ship);
+    }
+
+    static constexpr result_type min() noexcept { return 0; }
+
+    static constexpr result_type max() noexcept
+    {
+        return std::numeric_limits<result_type>::max();
+    }
+
+    // Starts over at the first draw of 'ship'
+    constexpr void Seek(const std::uint64_t ship) noexcept
+    {
+        _ship = ship;
+        _counter = { 0, 0, static_cast<std::uint32_t>(ship),
+            static_cast<std::uint32_t>(ship >> 32U) };
+        _used = _output.size();
+    }
+
+    [[nodiscard]] constexpr std::uint64_t Ship() const noexcept
+    {
+        return _ship;
+    }
+
+    constexpr result_type operator()() noexcept
+    {
+        if (_used == _output.size())
+        {
+            _output = Encrypt(_counter, _key);
+            _used = 0;
+
+            // A ship that needs 2^32 blocks carries into the second word
+            if (++_counter[0] == 0)
+            {
+                ++_counter[1];
+            }
+        }
+
+        const auto low = _output[_used];
+        const auto high = _output[_used + 1];
+        _used += 2;
+        return std::uint64_t{ high } << 32U | low;
+    }
+
+    static constexpr Block Encrypt(Block counter, Key key) noexcept
+    {
+        constexpr std::uint64_t multiplier0 = 0xD2511F53;
+        constexpr std::uint64_t multiplier1 = 0xCD9E8D57;
+        constexpr std::uint32_t weyl0 = 0x9E3779B9;
+        constexpr std::uint32_t weyl1 = 0xBB67AE85;
+
+        for (int round = 0; round < 10; ++round)
+        {
+            if (round != 0)
+            {
+                key[0] += weyl0;
+                key[1] += weyl1;
+            }
+
+            const auto product0 = multiplier0 * counter[0];
+            const auto product1 = multiplier1 * counter[2];
+
+            counter = { static_cast<std::uint32_t>(product1 >> 32U)
+                    ^ counter[1] ^ key[0],
+                static_cast<std::uint32_t>(product1),
+                static_cast<std::uint32_t>(product0 >> 32U) ^ counter[3]
+                    ^ key[1],
+                static_cast<std::uint32_t>(product0) };
+        }
+
+        return counter;
+    }
+
+private:
+    Key _key{};
+    Block _counter{};
+    Block _output{};
+    std::size_t _used{ 0 };
+    std::uint64_t _ship{ 0 };
+};
+
+// Known answers from the Random123 test vectors
+static_assert(Philox4x32::Encrypt({ 0, 0, 0, 0 }, { 0, 0 })
+    == Philox4x32::Block{ 0x6627E8D5, 0xE169C58D, 0xBC57AC4C, 0x9B00DBD8 });
+static_assert(Philox4x32::Encrypt(
+                  { 0x243F6A88, 0x85A308D3, 0x13198A2E, 0x03707344 },
+                  { 0xA4093822, 0x299F31D0 })
+    == Philox4x32::Block{ 0xD16CFE09, 0x94FDCCEB, 0x5001E420, 0x24126EA1 });
+
+static_assert(std::uniform_random_bit_generator<Xoshiro256StarStar>);
+static_assert(std::uniform_random_bit_generator<Pcg64>);
+static_assert(std::uniform_random_bit_generator<Philox4x32>);
+
+// Engines that can jump to the draws of any ship, generate_fleet starts
+// each ship on its own counter instead of where the last one stopped
+template<typename Rng>
+concept CounterBasedRng = std::uniform_random_bit_generator<Rng>
+    && requires(Rng& rng, const std::uint64_t ship)
+{
+    rng.Seek(ship);
+    {
+        rng.Ship()
+    }
+    ->std::convertible_to<std::uint64_t>;
+};
+
+// The engines --rng picks from, chosen once per run
+using Ship_Rng =
+    std::variant<Xoshiro256StarStar, Pcg64, std::mt19937, Philox4x32>;
+
+// 'first_ship' is where a counter-based engine starts, the others have no
+// notion of ship numbers
+Ship_Rng make_ship_rng(const std::string_view name, const std::uint64_t seed,
+    const std::uint64_t first_ship = 0)
+{
+    if (name == "philox")
+    {
+        return Philox4x32(seed, first_ship);
+    }
+
+    if (first_ship != 0)
+    {
+        throw std::runtime_error(
+            "only counter-based generators (philox) can start at a ship");
+    }
+
+    if (name == "xoshiro256**")
+    {
+        return Xoshiro256StarStar(seed);
+    }
+
+    if (name == "pcg64")
+    {
+        return Pcg64(seed);
+    }
+
+    if (name == "mt19937")
+    {
+        std::seed_seq sequence{ static_cast<std::uint32_t>(seed),
+            static_cast<std::uint32_t>(seed >> 32U) };
+        return std::mt19937(sequence);
+    }
+
+    throw std::runtime_error("unknown generator '" + std::string(name)
+        + "', expected xoshiro256**, pcg64, mt19937 or philox");
+}
+
+// The engine a thread builds ships with when it is not handed one, seeded
+// from the OS the first time the thread asks
+inline Xoshiro256StarStar& thread_rng()
+{
+    thread_local Xoshiro256StarStar rng(
+        std::uint64_t{ std::random_device{}() } << 32U
+        | std::random_device{}());
+    return rng;
+}
+
+// Uniform in [0, bound), Lemire's nearly divisionless method: the high half
+// of one random word times 'bound' is the draw, and a division is only
+// needed on the rare path where the low half says it might be biased.
+// Generators other than 32 or 64 full bits go through the standard
+// distribution
+template<std::uniform_random_bit_generator Rng>
+std::uint64_t bounded_draw(Rng& rng, const std::uint64_t bound)
+{
+    constexpr auto bits32 = Rng::min() == 0
+        && Rng::max() == std::numeric_limits<std::uint32_t>::max();
+    constexpr auto bits64 = Rng::min() == 0
+        && Rng::max() == std::numeric_limits<std::uint64_t>::max();
+
+    if constexpr (bits64)
+    {
+        __extension__ using Wide = unsigned __int128;
+
+        auto product = static_cast<Wide>(static_cast<std::uint64_t>(rng()))
+            * bound;
+
+        if (static_cast<std::uint64_t>(product) < bound)
+        {
+            const auto threshold = (0 - bound) % bound;
+
+            while (static_cast<std::uint64_t>(product) < threshold)
+            {
+                product = static_cast<Wide>(static_cast<std::uint64_t>(rng()))
+                    * bound;
+            }
+        }
+
+        return static_cast<std::uint64_t>(product >> 64U);
+    }
+    else if constexpr (bits32)
+    {
+        if (bound <= std::numeric_limits<std::uint32_t>::max())
+        {
+            const auto bound32 = static_cast<std::uint32_t>(bound);
+            auto product =
+                static_cast<std::uint64_t>(static_cast<std::uint32_t>(rng()))
+                * bound32;
+
+            if (static_cast<std::uint32_t>(product) < bound32)
+            {
+                const auto threshold =
+                    static_cast<std::uint32_t>(0 - bound32) % bound32;
+
+                while (static_cast<std::uint32_t>(product) < threshold)
+                {
+                    product = static_cast<std::uint64_t>(
+                                  static_cast<std::uint32_t>(rng()))
+                        * bound32;
+                }
+            }
+
+            return product >> 32U;
+        }
+    }
+
+    return std::uniform_int_distribution<std::uint64_t>(0, bound - 1)(rng);
+}
+
+// Constant-memory ingestion for stdin ('-'), pipes and FIFOs: lines are
+// classified as they arrive and only kept when they win a slot in their
+// type's reservoir, so memory is bounded by the chunk size plus the longest
+// line no matter how much is streamed in. That is one ship's worth of parts,
+// so a stream makes a single ship
+class PartStream
+{
+public:
+    // Streams are read in chunks instead of being mapped or buffered whole
+    static bool IsStream(const std::filesystem::path& fname);
+
+    // Which lines win the reservoirs depends on 'seed' and the lines alone
+    static PartStream Drain(
+        const std::filesystem::path& fname, std::uint64_t seed);
+
+    // The sampled parts of each type, a PartSource like the catalogs. Views
+    // are valid as long as this PartStream
+    [[nodiscard]] std::size_t Count(const Part_Type type) const noexcept
+    {
+        return _reservoirs[static_cast<std::size_t>(type)].size();
+    }
+
+    [[nodiscard]] std::string_view Part(
+        const Part_Type type, const std::size_t index) const noexcept
+    {
+        return _reservoirs[static_cast<std::size_t>(type)][index];
+    }
+
+    // Reservoirs hold a ship's worth of parts, walking them is cheaper
+    // than keeping an index
+    [[nodiscard]] Part_Id FirstId(const Part_Type type) const noexcept
+    {
+        Part_Id first = 0;
+
+        for (std::size_t i = 0; i < static_cast<std::size_t>(type); ++i)
+        {
+            first += static_cast<Part_Id>(_reservoirs[i].size());
+        }
+
+        return first;
+    }
+
+    [[nodiscard]] std::string_view Part(Part_Id id) const noexcept
+    {
+        std::size_t type = 0;
+
+        for (; id >= _reservoirs[type].size(); ++type)
+        {
+            id -= static_cast<Part_Id>(_reservoirs[type].size());
+        }
+
+        return _reservoirs[type][id];
+    }
+
+    [[nodiscard]] std::size_t LineCount() const noexcept { return _lineCount; }
+
+    // Lines that matched several categories, settled by rule priority
+    [[nodiscard]] std::size_t AmbiguousCount() const noexcept
+    {
+        return _ambiguousCount;
+    }
+
+private:
+    explicit PartStream(const std::uint64_t seed)
+        : _rng(seed),
+          _reservoirs(Taxonomy::Active().Categories().size()),
+          _seen(_reservoirs.size())
+    {
+    }
+
+    void Offer(std::string_view line);
+
+    Xoshiro256StarStar _rng;
+
+    // One reservoir per type, each as large as the type's slot count
+    std::vector<std::vector<std::string>> _reservoirs;
+    std::vector<std::size_t> _seen;
+    std::size_t _lineCount{ 0 };
+    std::size_t _ambiguousCount{ 0 };
+};
+
+bool PartStream::IsStream(const std::filesystem::path& fname)
+{
+    if (fname == "-")
+    {
+        return true;
+    }
+
+    const auto status = std::filesystem::status(fname);
+    return std::filesystem::is_fifo(status)
+        || std::filesystem::is_character_file(status);
+}
+
+PartStream PartStream::Drain(
+    const std::filesystem::path& fname, const std::uint64_t seed)
+{
+    // Duplicate stdin so closing our descriptor leaves it alone
+    const auto file = fname == "-" ? FileDescriptor(::dup(STDIN_FILENO))
+                                   : open_catalog(fname);
+
+    PartStream stream(seed);
+
+    constexpr std::size_t chunk_size = 64 * 1024;
+    const auto chunk = std::make_unique<char[]>(chunk_size);
+
+    // Holds the unfinished line at the end of a chunk
+    std::string carry;
+
+    while (const auto count =
+               read_some(file.Get(), chunk.get(), chunk_size, fname))
+    {
+        const char* pos = chunk.get();
+        const char* const end = pos + count;
+
+        while (const auto* const newline = static_cast<const char*>(
+                   std::memchr(pos, '\n', static_cast<std::size_t>(end - pos))))
+        {
+            const std::string_view line(
+                pos, static_cast<std::size_t>(newline - pos));
+
+            // Lines wholly inside the chunk are classified in place
+            if (carry.empty())
+            {
+                stream.Offer(line);
+            }
+            else
+            {
+                carry.append(line);
+                stream.Offer(carry);
+                carry.clear();
+            }
+
+            pos = newline + 1;
+        }
+
+        carry.append(pos, end);
+    }
+
+    // Same as std::getline, a final line without '\n' still counts
+    if (!carry.empty())
+    {
+        stream.Offer(carry);
+    }
+
+    return stream;
+}
+
+void PartStream::Offer(std::string_view line)
+{
+    ++_lineCount;
+
+    // Same CRLF handling as the mapped loader
+    if (!line.empty() && line.back() == '\r')
+    {
+        line.remove_suffix(1);
+    }
+
+    const auto [type, ambiguous] = classify_part(line);
+
+    _ambiguousCount += ambiguous ? 1 : 0;
+
+    if (!type)
+    {
+        return;
+    }
+
+    const auto index = static_cast<std::size_t>(*type);
+    auto& reservoir = _reservoirs[index];
+    const auto seen = _seen[index]++;
+
+    // Reservoir sampling (Algorithm R): every part of the type ends up kept
+    // with equal probability, matching the uniform pick of a full shuffle
+    if (seen < Taxonomy::Active().Categories()[index].slots)
+    {
+        reservoir.emplace_back(line);
+        return;
+    }
+
+    const auto slot = bounded_draw(_rng, seen + 1);
+
+    if (slot < reservoir.size())
+    {
+        // assign() reuses the slot's capacity
+        reservoir[slot].assign(line);
+    }
+}
+
+// A classified copy of a catalog file, never modified once it is published
+struct Catalog_Snapshot
+{
+    // Run of lines ending at a content-defined cut, so an edit only changes
+    // the segment it lands in and later segments keep their hashes
+    struct Segment
+    {
+        std::uint64_t hash{ 0 };
+        std::size_t first_line{ 0 };
+        std::size_t line_count{ 0 };
+    };
+
+    // Marks lines that matched no part type
+    static constexpr auto no_type =
+        static_cast<std::uint8_t>(Taxonomy::max_categories);
+
+    std::vector<char> bytes{};
+    std::vector<std::string_view> lines{};
+    std::vector<std::uint8_t> types{};
+    std::vector<Segment> segments{};
+    PartIndex parts{};
+
+    // Lines that had to be split and hashed, and of those classified, for
+    // this snapshot
+    std::size_t rescanned{ 0 };
+    std::size_t reclassified{ 0 };
+};
+
+// Splits 'bytes' into segments and classifies only those 'previous' did not
+// have, every other segment copies its line types from 'previous'. The
+// first 'prefix' and last 'suffix' bytes are known to match 'previous', the
+// segments inside them are taken over without splitting or hashing a line
+std::shared_ptr<const Catalog_Snapshot> build_snapshot(
+    std::vector<char>&& bytes, const Catalog_Snapshot* const previous,
+    const std::size_t prefix = 0, const std::size_t suffix = 0)
+{
+    // A line whose hash has these bits clear ends a segment, about 256
+    // lines per segment on average
+    constexpr std::uint64_t cut_mask = 0xFF;
+
+    auto snapshot = std::make_shared<Catalog_Snapshot>();
+    snapshot->bytes = std::move(bytes);
+
+    const char* const data = snapshot->bytes.data();
+    const auto size = snapshot->bytes.size();
+    auto& lines = snapshot->lines;
+    auto& types = snapshot->types;
+    auto& segments = snapshot->segments;
+
+    std::unordered_map<std::uint64_t, const Catalog_Snapshot::Segment*> known;
+
+    // Where line 'i' of 'previous' starts, and the same line moved into
+    // the new bytes
+    const auto old_start = [previous](const std::size_t i) {
+        return static_cast<std::size_t>(
+            previous->lines[i].data() - previous->bytes.data());
+    };
+
+    const auto moved = [&](const std::size_t i, const std::size_t pos) {
+        return std::string_view(data + pos, previous->lines[i].size());
+    };
+
+    std::size_t pos = 0;
+
+    if (previous != nullptr)
+    {
+        const auto& old = previous->segments;
+
+        for (const auto& segment : old)
+        {
+            known.emplace(segment.hash, &segment);
+        }
+
+        // Every segment the next one starts inside the prefix is unchanged.
+        // The last one never is, it was cut by the end of the file
+        std::size_t kept = 0;
+
+        while (kept + 1 < old.size()
+            && old_start(old[kept + 1].first_line) <= prefix)
+        {
+            ++kept;
+        }
+
+        if (kept != 0)
+        {
+            const auto line_count = old[kept].first_line;
+
+            for (std::size_t i = 0; i < line_count; ++i)
+            {
+                lines.push_back(moved(i, old_start(i)));
+            }
+
+            types.assign(previous->types.begin(),
+                previous->types.begin()
+                    + static_cast<std::ptrdiff_t>(line_count));
+            segments.assign(old.begin(),
+                old.begin() + static_cast<std::ptrdiff_t>(kept));
+            pos = old_start(line_count);
+        }
+    }
+
+    // Takes over every segment of 'previous' from the one starting at
+    // 'old_pos', when the bytes from 'pos' on are its unchanged suffix
+    const auto take_suffix = [&](const std::size_t old_pos) {
+        const auto& old = previous->segments;
+        const auto first = std::ranges::lower_bound(old, old_pos, {},
+            [&](const auto& segment) { return old_start(segment.first_line); });
+
+        if (first == old.end() || old_start(first->first_line) != old_pos)
+        {
+            return false;
+        }
+
+        const auto old_line = first->first_line;
+        const auto new_line = lines.size();
+
+        for (auto segment = first; segment != old.end(); ++segment)
+        {
+            segments.push_back(*segment);
+            segments.back().first_line = segment->first_line - old_line
+                + new_line;
+        }
+
+        for (auto i = old_line; i < previous->lines.size(); ++i)
+        {
+            lines.push_back(moved(i, old_start(i) - old_pos + pos));
+            types.push_back(previous->types[i]);
+        }
+
+        return true;
+    };
+
+    Catalog_Snapshot::Segment segment{ 0, lines.size(), 0 };
+
+    while (pos < size)
+    {
+        const auto* const newline =
+            static_cast<const char*>(std::memchr(data + pos, '\n', size - pos));
+
+        emit_line(data + pos, newline != nullptr ? newline : data + size,
+            lines);
+        pos = newline != nullptr ? static_cast<std::size_t>(newline - data) + 1
+                                 : size;
+        ++snapshot->rescanned;
+
+        const auto line_hash = hash_bytes(lines.back());
+        segment.hash = std::rotl(segment.hash, 7) ^ line_hash;
+        ++segment.line_count;
+
+        if ((line_hash & cut_mask) != 0 && pos != size)
+        {
+            continue;
+        }
+
+        const auto match = known.find(segment.hash);
+        types.resize(lines.size(), Catalog_Snapshot::no_type);
+        auto* const segment_types = types.data() + segment.first_line;
+
+        if (match != known.end()
+            && match->second->line_count == segment.line_count)
+        {
+            std::copy_n(previous->types.begin()
+                    + static_cast<std::ptrdiff_t>(match->second->first_line),
+                segment.line_count, segment_types);
+        }
+        else
+        {
+            for (std::size_t j = 0; j < segment.line_count; ++j)
+            {
+                if (const auto type =
+                        classify_part(lines[segment.first_line + j]).type)
+                {
+                    segment_types[j] = static_cast<std::uint8_t>(*type);
+                }
+            }
+
+            snapshot->reclassified += segment.line_count;
+        }
+
+        segments.push_back(segment);
+        segment = { 0, lines.size(), 0 };
+
+        // Past the edit, a cut that lands where an old segment began means
+        // the rest is the old segments again
+        if (previous != nullptr && pos != size && pos >= size - suffix
+            && take_suffix(pos + previous->bytes.size() - size))
+        {
+            break;
+        }
+    }
+
+    PartCatalog buckets;
+
+    for (std::size_t i = 0; i < lines.size(); ++i)
+    {
+        if (types[i] != Catalog_Snapshot::no_type)
+        {
+            buckets.Add(static_cast<Part_Type>(types[i]), lines[i]);
+        }
+    }
+
+    snapshot->parts =
+        PartIndex(buckets, Taxonomy::Active().Categories().size());
+    return snapshot;
+}
+
+// Keeps a classified snapshot of a catalog file current for a long-running
+// generator. An inotify thread notices writes (and editors replacing the
+// file), rebuilds the snapshot reusing every unchanged segment and swaps it
+// in; readers hold on to whatever snapshot they took, so they never wait on
+// a reload
+class CatalogWatcher
+{
+public:
+    explicit CatalogWatcher(std::filesystem::path fname);
+
+    ~CatalogWatcher() = default;
+
+    CatalogWatcher(const CatalogWatcher& other) = delete;
+    CatalogWatcher(CatalogWatcher&& other) = delete;
+    CatalogWatcher& operator=(const CatalogWatcher& other) = delete;
+    CatalogWatcher& operator=(CatalogWatcher&& other) = delete;
+
+    [[nodiscard]] std::shared_ptr<const Catalog_Snapshot> Current() const
+    {
+        const std::lock_guard lock(_mutex);
+        return _current;
+    }
+
+private:
+    // The file's bytes, and how many at the start and end are known to
+    // match the previous snapshot
+    struct Catalog_Read
+    {
+        std::vector<char> bytes;
+        std::size_t prefix;
+        std::size_t suffix;
+    };
+
+    // Reads the whole file with pread, a mapping could change under the
+    // snapshot's views while the file is being edited
+    [[nodiscard]] Catalog_Read ReadFile(
+        const Catalog_Snapshot* previous) const;
+
+    void Reload();
+
+    void Watch(const std::stop_token& stop);
+
+    std::filesystem::path _fname;
+
+    mutable std::mutex _mutex{};
+    std::shared_ptr<const Catalog_Snapshot> _current{};
+
+    // Declared last so it starts after everything it uses
+    std::jthread _thread{};
+};
+
+CatalogWatcher::CatalogWatcher(std::filesystem::path fname)
+    : _fname(std::move(fname))
+{
+    _current = build_snapshot(ReadFile(nullptr).bytes, nullptr);
+    _thread =
+        std::jthread([this](const std::stop_token& stop) { Watch(stop); });
+}
+
+CatalogWatcher::Catalog_Read CatalogWatcher::ReadFile(
+    const Catalog_Snapshot* const previous) const
+{
+    const auto file = open_catalog(_fname);
+
+    struct stat info
+    {
+    };
+
+    if (::fstat(file.Get(), &info) != 0)
+    {
+        std::stringstream err_mesg;
+        err_mesg << "file: '" << _fname.string() << "' could not be read!";
+        throw std::runtime_error(err_mesg.str());
+    }
+
+    // A writer still appending is picked up by the next event
+    std::vector<char> bytes(static_cast<std::size_t>(info.st_size));
+    bytes.resize(
+        pread_fully(file.Get(), bytes.data(), bytes.size(), 0, _fname));
+
+    if (previous == nullptr)
+    {
+        return { std::move(bytes), 0, 0 };
+    }
+
+    // Nothing short of reading every byte proves a range unchanged, an
+    // edit can land anywhere. Comparing is still far cheaper than splitting
+    // and hashing, and narrows those down to the changed range (after an
+    // append the old bytes are all prefix)
+    const auto& old = previous->bytes;
+    const auto prefix = static_cast<std::size_t>(
+        std::ranges::mismatch(bytes, old).in1 - bytes.begin());
+    const auto limit = std::min(bytes.size(), old.size()) - prefix;
+    const auto suffix = static_cast<std::size_t>(
+        std::mismatch(bytes.rbegin(),
+            bytes.rbegin() + static_cast<std::ptrdiff_t>(limit), old.rbegin())
+            .first
+        - bytes.rbegin());
+
+    return { std::move(bytes), prefix, suffix };
+}
+
+void CatalogWatcher::Reload()
+{
+    const auto previous = Current();
+    auto [bytes, prefix, suffix] = ReadFile(previous.get());
+    auto snapshot =
+        build_snapshot(std::move(bytes), previous.get(), prefix, suffix);
+
+    std::cerr << "Reloaded " << _fname.string() << ": "
+              << snapshot->rescanned << " of " << snapshot->lines.size()
+              << " lines rescanned, " << snapshot->reclassified
+              << " reclassified\n";
+
+    const std::lock_guard lock(_mutex);
+    _current = std::move(snapshot);
+}
+
+void CatalogWatcher::Watch(const std::stop_token& stop)
+{
+    const FileDescriptor notify(::inotify_init1(IN_CLOEXEC | IN_NONBLOCK));
+
+    // Watching the directory also sees editors that write a new file and
+    // rename it over the old one
+    const auto directory =
+        _fname.has_parent_path() ? _fname.parent_path() : ".";
+
+    if (notify.Get() < 0
+        || ::inotify_add_watch(notify.Get(), directory.c_str(),
+               IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE)
+            < 0)
+    {
+        std::cerr << "Exception: \"could not watch '" << _fname.string()
+                  << "' for changes\"\n";
+        return;
+    }
+
+    alignas(inotify_event) std::array<char, 4096> events{};
+    const auto name = _fname.filename().string();
+
+    // True when any pending event is about the catalog
+    const auto drain = [&] {
+        bool touched = false;
+
+        for (auto count = ::read(notify.Get(), events.data(), events.size());
+             count > 0;
+             count = ::read(notify.Get(), events.data(), events.size()))
+        {
+            for (auto pos = events.data(); pos < events.data() + count;)
+            {
+                const auto* const event =
+                    reinterpret_cast<const inotify_event*>(pos);
+
+                touched = touched || (event->len != 0 && name == event->name);
+                pos += sizeof(inotify_event) + event->len;
+            }
+        }
+
+        return touched;
+    };
+
+    pollfd poll_fd{ notify.Get(), POLLIN, 0 };
+
+    while (!stop.stop_requested())
+    {
+        // Short timeout so a stop request is noticed quickly
+        if (::poll(&poll_fd, 1, 200) <= 0 || !drain())
+        {
+            continue;
+        }
+
+        // Let a burst of writes settle before reading the file
+        while (::poll(&poll_fd, 1, 50) > 0)
+        {
+            drain();
+        }
+
+        try
+        {
+            Reload();
+        }
+        catch (const std::exception& ex)
+        {
+            // Keep serving the last good snapshot
+            std::cerr << "Exception: \"" << ex.what() << "\"\n";
+        }
+    }
+}
+
+// Binary catalog written by 'compile-catalog'. Parts are classified once and
+// stored grouped by type, so loading is one mmap plus a header check and no
+// byte of the part data is touched until a ship uses it.
+//
+// Layout (native endianness, every section 8-byte aligned):
+//   Compiled_Header
+//   per type: count + 1 uint64 file offsets, part i spans
+//             [offsets[i], offsets[i + 1])
+//   packed part bytes
+class CompiledCatalog
+{
+public:
+    static constexpr std::array<char, 8> magic{ 'S', 'H', 'I', 'P', 'C', 'A',
+        'T', '\0' };
+    static constexpr std::uint32_t version = 2;
+
+    ~CompiledCatalog() = default;
+
+    CompiledCatalog() = delete;
+
+    // Offset tables point into the owned mapping
+    CompiledCatalog(const CompiledCatalog& other) = delete;
+    CompiledCatalog& operator=(const CompiledCatalog& other) = delete;
+    CompiledCatalog(CompiledCatalog&& other) = default;
+    CompiledCatalog& operator=(CompiledCatalog&& other) = default;
+
+    // Checks the magic bytes without mapping the file
+    static bool IsCompiled(const std::filesystem::path& fname);
+
+    static CompiledCatalog Load(const std::filesystem::path& fname);
+
+    // Classifies every line of 'catalog' and writes the binary form to
+    // 'output', returns how many parts were stored
+    static std::size_t Compile(
+        const Catalog& catalog, const std::filesystem::path& output);
+
+    [[nodiscard]] std::size_t Count(const Part_Type type) const noexcept
+    {
+        const auto index = static_cast<std::size_t>(type);
+        return index < _counts.size() ? _counts[index] : 0;
+    }
+
+    // Offsets are only checked here, when a part is used, which keeps the
+    // load O(1). A corrupt entry reads as an empty part
+    [[nodiscard]] std::string_view Part(
+        const Part_Type type, const std::size_t index) const noexcept
+    {
+        const auto* const offsets = _offsets[static_cast<std::size_t>(type)];
+        const auto bytes = _mapping.Bytes();
+        const auto begin = offsets[index];
+        const auto end = offsets[index + 1];
+
+        if (begin > end || end > bytes.size())
+        {
+            return {};
+        }
+
+        return bytes.substr(begin, end - begin);
+    }
+
+    // Ids run through the types in table order
+    [[nodiscard]] Part_Id FirstId(const Part_Type type) const noexcept
+    {
+        return _first[static_cast<std::size_t>(type)];
+    }
+
+    [[nodiscard]] std::string_view Part(const Part_Id id) const noexcept
+    {
+        const auto next = std::upper_bound(_first.begin(), _first.end(), id);
+        const auto type = static_cast<Part_Type>(next - _first.begin() - 1);
+        return Part(type, id - FirstId(type));
+    }
+
+private:
+    struct Compiled_Table
+    {
+        std::uint64_t offsets_pos;
+        std::uint64_t count;
+    };
+
+    // Followed by one Compiled_Table per type
+    struct Compiled_Header
+    {
+        std::array<char, 8> magic;
+        std::uint32_t version;
+        std::uint32_t type_count;
+        std::uint64_t file_size;
+
+        // Parts are only grouped right under the taxonomy they were
+        // classified with
+        std::uint64_t taxonomy;
+    };
+
+    explicit CompiledCatalog(MappedFile&& mapping) noexcept
+        : _mapping(std::move(mapping))
+    {
+    }
+
+    MappedFile _mapping{};
+    std::vector<const std::uint64_t*> _offsets{};
+    std::vector<std::size_t> _counts{};
+
+    // First id of every type, plus one past the last part
+    std::vector<Part_Id> _first{};
+};
+
+bool CompiledCatalog::IsCompiled(const std::filesystem::path& fname)
+{
+    const FileDescriptor file(::open(fname.c_str(), O_RDONLY | O_CLOEXEC));
+    std::array<char, magic.size()> head{};
+
+    return file.Get() >= 0
+        && ::pread(file.Get(), head.data(), head.size(), 0)
+        == static_cast<ssize_t>(head.size())
+        && head == magic;
+}
+
+CompiledCatalog CompiledCatalog::Load(const std::filesystem::path& fname)
+{
+    const auto file = open_catalog(fname);
+    CompiledCatalog compiled(MappedFile::Map(file.Get()));
+
+    const auto bytes = compiled._mapping.Bytes();
+
+    // Only the header and the table bounds are validated, that is what keeps
+    // the load O(1) in the number of parts. Part() checks the offsets it uses
+    const auto corrupt = [&fname](const char* reason) {
+        std::stringstream err_mesg;
+        err_mesg << "file: '" << fname.string()
+                 << "' is not a valid compiled catalog (" << reason << ")!";
+        return std::runtime_error(err_mesg.str());
+    };
+
+    Compiled_Header header{};
+
+    if (bytes.size() < sizeof(header))
+    {
+        throw corrupt("truncated header");
+    }
+
+    std::memcpy(&header, bytes.data(), sizeof(header));
+
+    if (header.magic != magic || header.version != version)
+    {
+        throw corrupt("unsupported format");
+    }
+
+    if (header.file_size != bytes.size()
+        || header.type_count
+            > (bytes.size() - sizeof(header)) / sizeof(Compiled_Table))
+    {
+        throw corrupt("size mismatch");
+    }
+
+    const auto& taxonomy = Taxonomy::Active();
+
+    if (header.taxonomy != taxonomy.Fingerprint()
+        || header.type_count != taxonomy.Categories().size())
+    {
+        std::stringstream err_mesg;
+        err_mesg << "file: '" << fname.string()
+                 << "' was compiled with a different taxonomy!";
+        throw std::runtime_error(err_mesg.str());
+    }
+
+    compiled._offsets.resize(header.type_count);
+    compiled._counts.resize(header.type_count);
+    compiled._first.resize(header.type_count + 1);
+
+    for (std::size_t i = 0; i < header.type_count; ++i)
+    {
+        Compiled_Table table{};
+        std::memcpy(&table,
+            bytes.data() + sizeof(header) + i * sizeof(table), sizeof(table));
+
+        if (table.offsets_pos % alignof(std::uint64_t) != 0
+            || table.offsets_pos > bytes.size()
+            || table.count >= (bytes.size() - table.offsets_pos)
+                    / sizeof(std::uint64_t))
+        {
+            throw corrupt("offset table out of range");
+        }
+
+        const auto* const offsets = reinterpret_cast<const std::uint64_t*>(
+            bytes.data() + table.offsets_pos);
+
+        if (offsets[0] > offsets[table.count]
+            || offsets[table.count] > bytes.size())
+        {
+            throw corrupt("part data out of range");
+        }
+
+        if (table.count > std::numeric_limits<Part_Id>::max()
+                - compiled._first[i])
+        {
+            throw corrupt("more parts than part ids");
+        }
+
+        compiled._offsets[i] = offsets;
+        compiled._counts[i] = static_cast<std::size_t>(table.count);
+        compiled._first[i + 1] =
+            compiled._first[i] + static_cast<Part_Id>(table.count);
+    }
+
+    // Ships pick parts at random, read-ahead would be wasted
+    compiled._mapping.Advise(MADV_RANDOM);
+    return compiled;
+}
+
+std::size_t CompiledCatalog::Compile(
+    const Catalog& catalog, const std::filesystem::path& output)
+{
+    // The loader already grouped every part by type
+    const auto& buckets = catalog.Parts();
+
+    constexpr std::uint64_t alignment = alignof(std::uint64_t);
+
+    const auto align = [](const std::uint64_t pos) {
+        return (pos + alignment - 1) & ~(alignment - 1);
+    };
+
+    const auto& taxonomy = Taxonomy::Active();
+    const auto type_count = taxonomy.Categories().size();
+
+    // First pass lays out the tables, the part bytes follow all of them
+    Compiled_Header header{ magic, version,
+        static_cast<std::uint32_t>(type_count), 0, taxonomy.Fingerprint() };
+    std::vector<Compiled_Table> tables(type_count);
+    std::uint64_t pos = sizeof(header) + sizeof(Compiled_Table) * type_count;
+    std::size_t part_count = 0;
+
+    for (std::size_t i = 0; i < type_count; ++i)
+    {
+        const auto count = buckets.Count(static_cast<Part_Type>(i));
+
+        tables[i] = { pos, count };
+        pos += (count + 1) * sizeof(std::uint64_t);
+        part_count += count;
+    }
+
+    std::uint64_t data_pos = pos;
+
+    // Calls 'fn' on every part, grouped by type in table order
+    const auto for_each_part = [&](auto&& fn, auto&& end_of_type) {
+        for (std::size_t i = 0; i < type_count; ++i)
+        {
+            const auto type = static_cast<Part_Type>(i);
+
+            for (std::size_t j = 0; j < buckets.Count(type); ++j)
+            {
+                fn(buckets.Part(type, j));
+            }
+
+            end_of_type();
+        }
+    };
+
+    for_each_part([&pos](const auto part) { pos += part.size(); }, [] {});
+
+    header.file_size = align(pos);
+
+    // Written beside the target and renamed over it, so a reader never maps
+    // a half-written catalog
+    auto temp_name = output;
+    temp_name += ".tmp";
+
+    std::ofstream file(temp_name, std::ios::binary | std::ios::trunc);
+
+    if (!file.is_open())
+    {
+        std::stringstream err_mesg;
+        err_mesg << "file: '" << temp_name.string() << "' could not be opened!";
+        throw std::runtime_error(err_mesg.str());
+    }
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(tables.data()),
+        static_cast<std::streamsize>(sizeof(Compiled_Table) * type_count));
+
+    const auto write_offset = [&file, &data_pos] {
+        file.write(reinterpret_cast<const char*>(&data_pos), sizeof(data_pos));
+    };
+
+    for_each_part(
+        [&](const auto part) {
+            write_offset();
+            data_pos += part.size();
+        },
+        write_offset);
+
+    for_each_part(
+        [&file](const auto part) {
+            file.write(part.data(), static_cast<std::streamsize>(part.size()));
+        },
+        [] {});
+
+    // Pad to the recorded size
+    constexpr std::array<char, alignment> padding{};
+    file.write(padding.data(),
+        static_cast<std::streamsize>(header.file_size - data_pos));
+    file.close();
+
+    if (!file)
+    {
+        // A partial catalog is no use to anyone
+        std::error_code ignored;
+        std::filesystem::remove(temp_name, ignored);
+
+        std::stringstream err_mesg;
+        err_mesg << "file: '" << temp_name.string()
+                 << "' could not be written!";
+        throw std::runtime_error(err_mesg.str());
+    }
+
+    std::filesystem::rename(temp_name, output);
+    return part_count;
+}
+
+class Spaceship
+{
+public:
+    ~Spaceship() = default;
+
+    // Deleting default constructor
+    Spaceship() = delete;
+
+    // Marks a slot no part was found for
+    static constexpr Part_Id no_part = std::numeric_limits<Part_Id>::max();
+
+    // Using constructor instead of static function
+    // Making constructor explicit and noexcept
+    // Picks straight from pre-grouped parts, nothing is shuffled or
+    // classified, so a ship costs O(slots) whatever the catalog size.
+    // Parts are kept as ids, the source must outlive the Spaceship. Draws
+    // from the calling thread's engine, nothing is seeded per ship
+    template<IndexedPartSource Source>
+    explicit Spaceship(const Source& source) noexcept;
+
+    // Draws from the caller's generator instead of a freshly seeded one
+    template<IndexedPartSource Source, std::uniform_random_bit_generator Rng>
+    Spaceship(const Source& source, Rng& rng) noexcept
+    {
+        Refit(source, rng);
+    }
+
+    explicit Spaceship(const Catalog& catalog) noexcept
+        : Spaceship(catalog.Parts())
+    {
+    }
+
+    // A temporary catalog would leave every part dangling
+    explicit Spaceship(Catalog&& catalog) = delete;
+    explicit Spaceship(CompiledCatalog&& catalog) = delete;
+
+    // Spaceship can be copy/move constructed and assigned
+    Spaceship(const Spaceship& other) = default;
+    Spaceship(Spaceship&& other) = default;
+    Spaceship& operator=(const Spaceship& other) = default;
+    Spaceship& operator=(Spaceship&& other) = default;
+
+    // Spaceship for the Spaceship 🙂 Compares part ids, so only ships
+    // built from the same source compare meaningfully
+    std::strong_ordering operator<=>(const Spaceship& other) const noexcept
+    {
+        return _slots <=> other._slots;
+    }
+
+    bool operator==(const Spaceship& other) const noexcept
+    {
+        return _slots == other._slots;
+    }
+
+    // The picked part ids, one entry per slot of every category
+    [[nodiscard]] const std::vector<std::vector<Part_Id>>& Ids() const noexcept
+    {
+        return _slots;
+    }
+
+    // Picks a new set of parts in place, keeping every buffer, so a fleet
+    // allocates nothing after its first ship
+    template<IndexedPartSource Source, std::uniform_random_bit_generator Rng>
+    void Refit(const Source& source, Rng& rng) noexcept;
+
+    // Print is a bit prettier, the layout of each category comes from the
+    // active taxonomy
+    void Print(std::ostream& out = std::cout) const noexcept
+    {
+        try
+        {
+            std::string text;
+            Render(text);
+            out << text;
+        }
+        catch (const std::exception& ex)
+        {
+            std::cerr << "Exception: \"" << ex.what() << "\"\n";
+        }
+    }
+
+    // Appends what Print() shows to 'text', throws when a single-part
+    // category has no part
+    void Render(std::string& text) const
+    {
+        const auto& categories = Taxonomy::Active().Categories();
+
+        // Strings are only looked up here
+        const auto part = [this](const Part_Id id) {
+            return id == no_part ? std::string_view{} : _part(_source, id);
+        };
+
+        // This would be a great place for std::format
+        text += "\nThis ship is loaded with:";
+
+        for (std::size_t i = 0; i < categories.size(); ++i)
+        {
+            const auto& category = categories[i];
+            const auto& parts = _slots[i];
+
+            text.append("\n  ").append(category.name) += ':';
+
+            if (!category.labels.empty())
+            {
+                for (std::size_t j = 0; j < parts.size(); ++j)
+                {
+                    text.append("\n    (")
+                        .append(category.labels[j])
+                        .append("): ")
+                        .append(part(parts[j]));
+                }
+            }
+            else if (parts.size() == 1)
+            {
+                // A ship is not complete without its single parts
+                if (parts.front() == no_part)
+                {
+                    throw std::out_of_range(
+                        "no part for '" + category.name + "'");
+                }
+
+                text.append(" ").append(part(parts.front()));
+            }
+            else
+            {
+                text += " [";
+
+                // Using C++20 ranges
+                for (const auto id : std::views::all(parts)
+                        | std::views::take(parts.size() - 1))
+                {
+                    text.append(part(id)).append(", ");
+                }
+
+                text.append(part(parts.back())) += ']';
+            }
+        }
+
+        text += '\n';
+    }
+
+private:
+    // Ids into the source, building a ship touches no part strings. One
+    // entry per slot of every category, no_part until filled
+    std::vector<std::vector<Part_Id>> _slots{};
+
+    // The source, and how to look an id up in it, for printing
+    const void* _source{ nullptr };
+    std::string_view (*_part)(const void*, Part_Id){ nullptr };
+};
+
+template<IndexedPartSource Source>
+Spaceship::Spaceship(const Source& source) noexcept
+{
+    Refit(source, thread_rng());
+}
+
+template<IndexedPartSource Source, std::uniform_random_bit_generator Rng>
+void Spaceship::Refit(const Source& source, Rng& rng) noexcept
+{
+    _source = &source;
+    _part = [](const void* const from, const Part_Id id) {
+        return std::string_view(static_cast<const Source*>(from)->Part(id));
+    };
+
+    const auto& categories = Taxonomy::Active().Categories();
+    _slots.resize(categories.size());
+
+    for (std::size_t type = 0; type < categories.size(); ++type)
+    {
+        auto& slots = _slots[type];
+        slots.assign(categories[type].slots, no_part);
+
+        const auto count = source.Count(static_cast<Part_Type>(type));
+
+        if (count == 0)
+        {
+            continue;
+        }
+
+        const auto first = source.FirstId(static_cast<Part_Type>(type));
+        const auto picks = std::min(slots.size(), count);
+
+        // Slot i draws among the count - i ids still free and takes the
+        // free id of that rank, every ordered selection has the odds of
+        // shuffling the bucket and taking the first few. Nothing is redrawn
+        // however few parts the category has
+        for (std::size_t i = 0; i < picks; ++i)
+        {
+            const auto rank =
+                first + static_cast<Part_Id>(bounded_draw(rng, count - i));
+            const auto taken = std::span(slots).first(i);
+
+            // The free id of that rank is 'rank' plus the taken ids at or
+            // below it, counting again until the count settles
+            std::size_t skipped = 0;
+
+            while (true)
+            {
+                const auto below = static_cast<std::size_t>(
+                    std::ranges::count_if(taken, [&](const Part_Id id) {
+                        return id <= rank + skipped;
+                    }));
+
+                if (below == skipped)
+                {
+                    break;
+                }
+
+                skipped = below;
+            }
+
+            slots[i] = rank + static_cast<Part_Id>(skipped);
+        }
+    }
+}
+
+// Moves a counter-based engine on to the start of the next ship, however
+// many draws the last one took. Other engines just carry on
+template<std::uniform_random_bit_generator Rng>
+constexpr void next_ship(Rng& rng) noexcept
+{
+    if constexpr (CounterBasedRng<Rng>)
+    {
+        rng.Seek(rng.Ship() + 1);
+    }
+}
+
+// Builds 'count' ships from 'source' one after another and hands each to
+// 'fn'. One Spaceship is refitted for all of them, so nothing is allocated
+// per ship and the ship passed to 'fn' is only valid during the call. With
+// a counter-based engine the ships are numbered from where it stands and
+// it is left at the next number, so each ship is the same whatever was
+// generated before it, in this call or an earlier one
+template<IndexedPartSource Source, std::uniform_random_bit_generator Rng,
+    std::invocable<const Spaceship&> Fn>
+void generate_fleet(
+    const Source& source, const std::size_t count, Rng& rng, Fn&& fn)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    Spaceship ship(source, rng);
+    next_ship(rng);
+    fn(std::as_const(ship));
+
+    for (std::size_t i = 1; i < count; ++i)
+    {
+        ship.Refit(source, rng);
+        next_ship(rng);
+        fn(std::as_const(ship));
+    }
+}
+
+// Whether a parallel fleet comes out in ship order, or chunk by chunk as
+// the workers finish them
+enum class Fleet_Order : uint8_t
+{
+    Ordered,
+    Unordered
+};
+
+// A run of consecutive chunks, [front, back) packed into one word so a
+// worker pops its front and thieves split off its back with a single CAS.
+// Chunk numbers are never handed out twice, so a stale range cannot match
+using Chunk_Range = std::uint64_t;
+
+constexpr Chunk_Range make_chunk_range(
+    const std::uint32_t front, const std::uint32_t back) noexcept
+{
+    return std::uint64_t{ back } << 32U | front;
+}
+
+constexpr std::uint32_t chunk_front(const Chunk_Range range) noexcept
+{
+    return static_cast<std::uint32_t>(range);
+}
+
+constexpr std::uint32_t chunk_back(const Chunk_Range range) noexcept
+{
+    return static_cast<std::uint32_t>(range >> 32U);
+}
+
+// Everything one fleet worker touches. The range is read by thieves, the
+// rest only by its owner, each on its own cache line
+template<CounterBasedRng Rng>
+struct alignas(64) Fleet_Worker
+{
+    std::atomic<Chunk_Range> chunks{ 0 };
+    alignas(64) std::optional<Rng> rng{};
+    std::optional<Spaceship> ship{};
+    std::string text{};
+};
+
+// A chunk's text, padded so two workers never write the same cache line
+struct alignas(64) Fleet_Chunk
+{
+    std::string text{};
+};
+
+// More workers than this are refused, far past any core count a fleet
+// has been built on
+constexpr std::size_t max_fleet_threads = 256;
+
+// generate_fleet on 'threads' workers, each building whole chunks of ships
+// with its own copy of 'rng'. Ship i depends only on i, so the output is
+// the same for any thread count. 'sink' gets the rendered text, never from
+// two threads at once. Ordered fleets go out in batches: the workers build
+// one while this thread writes the one before. Like generate_fleet, 'rng'
+// is left at the ship after the fleet
+template<IndexedPartSource Source, CounterBasedRng Rng,
+    std::invocable<std::string_view> Sink>
+void generate_fleet_parallel(const Source& source, const std::size_t count,
+    Rng& rng, const std::size_t threads, const Fleet_Order order,
+    Sink&& sink)
+{
+    // Big enough to pay for a steal, small enough to even out the tail
+    constexpr std::size_t chunk_size = 256;
+    constexpr std::size_t chunks_per_worker = 8;
+
+    if (count == 0)
+    {
+        return;
+    }
+
+    const auto chunk_count = (count + chunk_size - 1) / chunk_size;
+
+    if (chunk_count > std::numeric_limits<std::uint32_t>::max())
+    {
+        throw std::runtime_error("fleet is too large to split into chunks");
+    }
+
+    const auto ordered = order == Fleet_Order::Ordered;
+    const auto batch_chunks =
+        ordered ? threads * chunks_per_worker : chunk_count;
+    const auto first_ship = rng.Ship();
+
+    std::vector<Fleet_Worker<Rng>> workers(threads);
+
+    // Two batches in flight at most, the one being built and the one
+    // being written
+    std::vector<Fleet_Chunk> texts(ordered ? 2 * batch_chunks : 0);
+    std::array<std::atomic<std::size_t>, 2> remaining{};
+
+    // Bumped for every new batch, workers sleep on it when out of work
+    constexpr std::size_t finished = std::numeric_limits<std::size_t>::max();
+    std::atomic<std::size_t> generation{ 0 };
+
+    std::mutex mutex;
+    std::exception_ptr error;
+    std::atomic<bool> failed{ false };
+
+    // The front of the worker's own range, else half of someone else's
+    const auto take =
+        [&](const std::size_t self) -> std::optional<std::uint32_t> {
+        auto& own = workers[self].chunks;
+
+        for (auto range = own.load(); chunk_front(range) < chunk_back(range);)
+        {
+            const auto front = chunk_front(range);
+
+            if (own.compare_exchange_weak(
+                    range, make_chunk_range(front + 1, chunk_back(range))))
+            {
+                return front;
+            }
+        }
+
+        for (std::size_t i = 1; i < threads; ++i)
+        {
+            auto& victim = workers[(self + i) % threads].chunks;
+
+            for (auto range = victim.load();
+                 chunk_front(range) < chunk_back(range);)
+            {
+                const auto front = chunk_front(range);
+                const auto back = chunk_back(range);
+                const auto middle = back - (back - front + 1) / 2;
+
+                if (victim.compare_exchange_weak(
+                        range, make_chunk_range(front, middle)))
+                {
+                    // Only this worker fills its own range, and only empty
+                    own.store(make_chunk_range(middle + 1, back));
+                    return middle;
+                }
+            }
+        }
+
+        return std::nullopt;
+    };
+
+    const auto build = [&](Fleet_Worker<Rng>& worker, const std::size_t chunk) {
+        auto& text = ordered ? texts[chunk % texts.size()].text : worker.text;
+        text.clear();
+
+        const auto begin = chunk * chunk_size;
+        const auto end = std::min(count, begin + chunk_size);
+
+        for (auto i = begin; i < end; ++i)
+        {
+            worker.rng->Seek(first_ship + i);
+
+            if (worker.ship)
+            {
+                worker.ship->Refit(source, *worker.rng);
+            }
+            else
+            {
+                worker.ship.emplace(source, *worker.rng);
+            }
+
+            worker.ship->Render(text);
+        }
+
+        if (!ordered)
+        {
+            const std::lock_guard lock(mutex);
+            sink(std::string_view(text));
+        }
+    };
+
+    const auto work = [&](const std::size_t self) {
+        auto& worker = workers[self];
+        worker.rng.emplace(rng);
+
+        while (true)
+        {
+            // Read before looking for work, a batch started in between
+            // then wakes the wait below straight away
+            const auto seen = generation.load();
+
+            if (seen == finished)
+            {
+                return;
+            }
+
+            while (const auto chunk = take(self))
+            {
+                try
+                {
+                    if (!failed)
+                    {
+                        build(worker, *chunk);
+                    }
+                }
+                catch (...)
+                {
+                    const std::lock_guard lock(mutex);
+                    error = std::current_exception();
+                    failed = true;
+                }
+
+                // Failed chunks are still counted, nobody waits forever
+                auto& left = remaining[*chunk / batch_chunks % 2];
+
+                if (left.fetch_sub(1) == 1)
+                {
+                    left.notify_all();
+                }
+            }
+
+            generation.wait(seen);
+        }
+    };
+
+    // Deals the batch's chunks out as one contiguous range per worker.
+    // Every range is empty by then, the previous batch is done
+    const auto start_batch = [&](const std::size_t batch) {
+        const auto begin = batch * batch_chunks;
+        const auto end = std::min(chunk_count, begin + batch_chunks);
+
+        remaining[batch % 2] = end - begin;
+
+        for (std::size_t i = 0; i < threads; ++i)
+        {
+            workers[i].chunks.store(make_chunk_range(
+                static_cast<std::uint32_t>(begin + (end - begin) * i / threads),
+                static_cast<std::uint32_t>(
+                    begin + (end - begin) * (i + 1) / threads)));
+        }
+
+        ++generation;
+        generation.notify_all();
+    };
+
+    const auto wait_batch = [&](const std::size_t batch) {
+        auto& left = remaining[batch % 2];
+
+        for (auto value = left.load(); value != 0; value = left.load())
+        {
+            left.wait(value);
+        }
+    };
+
+    const auto batch_count = (chunk_count + batch_chunks - 1) / batch_chunks;
+
+    {
+        std::vector<std::jthread> pool;
+
+        // Stops the workers however this scope is left
+        const auto stop = [&] {
+            generation = finished;
+            generation.notify_all();
+        };
+
+        try
+        {
+            for (std::size_t i = 0; i < threads; ++i)
+            {
+                pool.emplace_back(work, i);
+            }
+
+            if (batch_count != 0)
+            {
+                start_batch(0);
+            }
+
+            for (std::size_t batch = 0; batch < batch_count && !failed;
+                 ++batch)
+            {
+                wait_batch(batch);
+
+                if (failed)
+                {
+                    break;
+                }
+
+                if (batch + 1 < batch_count)
+                {
+                    start_batch(batch + 1);
+                }
+
+                const auto begin = batch * batch_chunks;
+                const auto end = std::min(chunk_count, begin + batch_chunks);
+
+                for (auto chunk = begin; ordered && chunk < end; ++chunk)
+                {
+                    sink(std::string_view(texts[chunk % texts.size()].text));
+                }
+            }
+        }
+        catch (...)
+        {
+            stop();
+            throw;
+        }
+
+        stop();
+    }
+
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+
+    rng.Seek(first_ship + count);
+}
+
+// Replaces each directory argument with the regular files below it, sorted so
+// the merge order (and with it which duplicate survives) is stable
+std::vector<std::filesystem::path> expand_catalog_paths(
+    const std::span<const char* const> args)
+{
+    std::vector<std::filesystem::path> fnames;
+
+    for (const std::filesystem::path arg : args)
+    {
+        if (!std::filesystem::is_directory(arg))
+        {
+            fnames.push_back(arg);
+            continue;
+        }
+
+        const auto first = fnames.size();
+
+        for (const auto& entry :
+            std::filesystem::recursive_directory_iterator(arg))
+        {
+            if (entry.is_regular_file())
+            {
+                fnames.push_back(entry.path());
+            }
+        }
+
+        std::sort(fnames.begin() + static_cast<std::ptrdiff_t>(first),
+            fnames.end());
+    }
+
+    return fnames;
+}
+
+// Using concepts, pretty trivial example but wanted to use it
+template<typename T>
+concept PathType = std::constructible_from<std::filesystem::path, T>;
+
+// Random part names over the real keywords, for benchmarking big catalogs
+std::string make_synthetic_catalog(const std::size_t size)
+{
+    constexpr std::array adjectives{ "super", "small", "big", "large",
+        "ionizing", "lightspeed", "V-shaped", "X-style", "falcon-style",
+        "streamline", "tie-fighter", "liquid", "100% energy field", "laser",
+        "rocket resistant", "bubble gum", "string tokens" };
+    constexpr std::array nouns{ "rocket", "plane", "cannon", "launcher",
+        "field", "shield", "module", "assembly" };
+
+    // Fixed seed so every run measures the same bytes
+    std::mt19937 g(2020);
+    std::string catalog;
+    catalog.reserve(size + 128);
+
+    const auto pick = [&g](const auto& words) {
+        return words[std::uniform_int_distribution<std::size_t>(
+            0, words.size() - 1)(g)];
+    };
+
+    while (catalog.size() < size)
+    {
+        const auto word_count =
+            std::uniform_int_distribution<std::size_t>(1, 4)(g);
+
+        for (std::size_t i = 0; i < word_count; ++i)
+        {
+            catalog.append(pick(adjectives)).push_back(' ');
+        }
+
+        catalog.append(pick(nouns)).push_back(' ');
+        catalog.append(pick(part_types_list).keyword);
+
+        // A quarter of the lines end in a model suffix instead of their
+        // keyword, half of those name a second type to settle by priority
+        const auto suffix = std::uniform_int_distribution<int>(0, 7)(g);
+
+        if (suffix == 0)
+        {
+            catalog.append(" ").append(pick(part_types_list).keyword);
+        }
+
+        if (suffix < 2)
+        {
+            catalog.append(" mk2");
+        }
+
+        catalog.push_back('\n');
+    }
+
+    return catalog;
+}
+
+// Best wall time of 'runs' calls
+template<typename Fn>
+double best_seconds(const int runs, Fn&& fn)
+{
+    auto best = std::chrono::duration<double>::max();
+
+    for (int i = 0; i < runs; ++i)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        fn();
+        best = std::min<std::chrono::duration<double>>(
+            best, std::chrono::steady_clock::now() - start);
+    }
+
+    return best.count();
+}
+
+// 'bench [MiB]': throughput of the hot loading kernels on a synthetic catalog
+void run_benchmarks(const std::size_t mebibytes)
+{
+    const auto catalog = make_synthetic_catalog(mebibytes << 20U);
+    constexpr int runs = 5;
+
+    std::vector<std::string_view> lines;
+    split_lines_scalar(catalog, lines);
+
+    const auto line_count = lines.size();
+    const auto gigabytes = static_cast<double>(catalog.size()) / 1e9;
+
+    std::cout << "Synthetic catalog: " << mebibytes << " MiB, " << line_count
+              << " lines\n\nLine splitting:\n";
+
+    for (const auto& splitter : available_line_splitters())
+    {
+        const auto seconds = best_seconds(runs, [&] {
+            // Capacity is kept, so only the scan itself is timed
+            lines.clear();
+            splitter.split(catalog, lines);
+        });
+
+        if (lines.size() != line_count)
+        {
+            throw std::runtime_error(
+                std::string(splitter.name) + " kernel split the wrong lines");
+        }
+
+        std::cout << "  " << std::left << std::setw(8) << splitter.name
+                  << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(8) << gigabytes / seconds << " GB/s\n";
+    }
+
+    std::cout << "\nClassification:\n";
+
+    const auto classify_all = [&lines](const auto classify) {
+        std::size_t matched = 0;
+
+        for (const auto line : lines)
+        {
+            matched += classify(line).type.has_value() ? 1 : 0;
+        }
+
+        return matched;
+    };
+
+    // The built-in rules compiled the way a taxonomy file would be
+    static const auto builtin = Taxonomy::Builtin();
+    static const Taxonomy compiled(builtin.Categories(), builtin.Rules());
+
+    // Synthetic parts are already folded, this is what --normalize costs
+    static const auto normalized = builtin.Normalized();
+
+    const std::array<std::pair<const char*,
+                         Part_Match (*)(std::string_view)>,
+        4>
+        classifiers{ { { "find", classify_part_find },
+            { "hashed", classify_part_builtin },
+            { "dfa", [](const std::string_view line) {
+                 return compiled.Classify(line);
+             } },
+            { "folded", [](const std::string_view line) {
+                 return normalized.Classify(line);
+             } } } };
+
+    for (const auto& [name, classify] : classifiers)
+    {
+        // Stored so the scan can't be optimised away
+        volatile std::size_t matched = 0;
+        const auto seconds =
+            best_seconds(runs, [&] { matched = classify_all(classify); });
+
+        // Has to agree with the reference on every single line
+        if (!std::ranges::all_of(lines, [classify = classify](const auto line) {
+                return classify(line) == classify_part_find(line);
+            }))
+        {
+            throw std::runtime_error(
+                std::string(name) + " classifier disagrees with find");
+        }
+
+        std::cout << "  " << std::left << std::setw(8) << name << std::right
+                  << std::setw(8) << gigabytes / seconds << " GB/s\n";
+    }
+
+    std::cout << "\nKeyword scan:\n";
+
+    // Only parts without a trailing keyword get this far
+    std::vector<std::string_view> scanned;
+    std::size_t scanned_bytes = 0;
+
+    for (const auto line : lines)
+    {
+        if (!keyword_tokens.Find(trailing_token(line)))
+        {
+            scanned.push_back(line);
+            scanned_bytes += line.size() + 1;
+        }
+    }
+
+    const auto scanned_gigabytes = static_cast<double>(scanned_bytes) / 1e9;
+    auto matchers = available_keyword_matchers();
+    matchers.insert(matchers.begin(), { "find", classify_part_find });
+
+    for (const auto& [name, match] : matchers)
+    {
+        volatile std::size_t matched = 0;
+        const auto seconds = best_seconds(runs, [&, match = match] {
+            std::size_t count = 0;
+
+            for (const auto line : scanned)
+            {
+                count += match(line).type.has_value() ? 1 : 0;
+            }
+
+            matched = count;
+        });
+
+        if (!std::ranges::all_of(scanned, [match = match](const auto line) {
+                return match(line) == classify_part_find(line);
+            }))
+        {
+            throw std::runtime_error(
+                std::string(name) + " keyword scan disagrees with find");
+        }
+
+        std::cout << "  " << std::left << std::setw(10) << name << std::right
+                  << std::setw(8) << scanned_gigabytes / seconds << " GB/s\n";
+    }
+
+    std::cout << "\nParse and classify:\n";
+
+    // One task is the sequential loader, the widest run uses every core
+    const auto cores = std::max(1U, std::thread::hardware_concurrency());
+
+    for (const auto tasks : { 1U, cores })
+    {
+        const auto seconds = best_seconds(runs, [&] {
+            std::vector<std::string_view> parsed;
+            PartCatalog buckets;
+            parse_catalog_parallel(catalog, tasks, parsed, buckets);
+        });
+
+        std::cout << "  " << std::setw(3) << tasks << " task(s) "
+                  << std::setw(8) << gigabytes / seconds << " GB/s\n";
+
+        if (cores == 1)
+        {
+            break;
+        }
+    }
+
+    std::cout << "\nFleet generation:\n";
+
+    PartCatalog buckets;
+    classify_lines(lines, buckets);
+
+    const PartIndex parts(buckets, Taxonomy::Active().Categories().size());
+    constexpr std::size_t fleet_size = 1U << 20U;
+
+    // Picking alone with each engine, then picking and rendering into a
+    // reused buffer
+    const std::array<std::pair<const char*, bool>, 5> runs_of{ {
+        { "mt19937", false },
+        { "pcg64", false },
+        { "philox", false },
+        { "xoshiro256**", false },
+        { "xoshiro256**", true },
+    } };
+
+    for (const auto& [engine, render] : runs_of)
+    {
+        auto rng = make_ship_rng(engine, 2020);
+        std::string text;
+        volatile std::size_t checksum = 0;
+
+        const auto seconds = best_seconds(runs, [&, render = render] {
+            std::size_t sum = 0;
+
+            std::visit(
+                [&](auto& g) {
+                    generate_fleet(
+                        parts, fleet_size, g, [&](const Spaceship& ship) {
+                            if (render)
+                            {
+                                text.clear();
+                                ship.Render(text);
+                                sum += text.size();
+                            }
+                            else
+                            {
+                                sum += ship.Ids().front().front();
+                            }
+                        });
+                },
+                rng);
+
+            checksum = sum;
+        });
+
+        const auto ships = static_cast<double>(fleet_size) / seconds;
+
+        std::cout << "  " << std::left << std::setw(7)
+                  << (render ? "render" : "pick") << std::setw(13) << engine
+                  << std::right << std::setw(8) << ships / 1e6
+                  << " M ships/s\n";
+    }
+
+    // Rendered on one worker and on every core, written out in order
+    for (const auto threads : { 1U, cores })
+    {
+        volatile std::size_t checksum = 0;
+
+        const auto seconds = best_seconds(runs, [&] {
+            std::size_t sum = 0;
+            Philox4x32 rng(2020);
+
+            generate_fleet_parallel(parts, fleet_size, rng, threads,
+                Fleet_Order::Ordered,
+                [&sum](const std::string_view text) { sum += text.size(); });
+
+            checksum = sum;
+        });
+
+        const auto ships = static_cast<double>(fleet_size) / seconds;
+
+        std::cout << "  render " << std::setw(3) << threads << " thread(s) "
+                  << std::setw(8) << ships / 1e6 << " M ships/s\n";
+
+        if (cores == 1)
+        {
+            break;
+        }
+    }
+}
+
+int main(const int argc, const char* const argv[]) noexcept
+{
+    try
+    {
+        // Options come first, then the mode and its arguments
+        auto args = std::span(argv + 1, static_cast<std::size_t>(argc - 1));
+        std::optional<std::filesystem::path> cache_name;
+        bool normalize = false;
+        std::size_t fuzzy_distance = 0;
+        std::size_t ship_count = 1;
+        std::optional<std::string_view> rng_name;
+        std::optional<std::uint64_t> seed;
+        std::uint64_t first_ship = 0;
+        std::size_t thread_count = 1;
+        auto fleet_order = Fleet_Order::Ordered;
+
+        while (!args.empty() && std::string_view(args[0]).starts_with("--"))
+        {
+            const std::string_view option = args[0];
+
+            // --normalize and --unordered, the options without a value
+            if (option == "--normalize")
+            {
+                normalize = true;
+                args = args.subspan(1);
+                continue;
+            }
+
+            if (option == "--unordered")
+            {
+                fleet_order = Fleet_Order::Unordered;
+                args = args.subspan(1);
+                continue;
+            }
+
+            if (args.size() < 2)
+            {
+                throw std::runtime_error(
+                    "option '" + std::string(option) + "' needs a value");
+            }
+
+            // --taxonomy <file>
+            if (option == "--taxonomy")
+            {
+                Taxonomy::Activate(Taxonomy::Load(args[1]));
+            }
+            // --cache <file>
+            else if (option == "--cache")
+            {
+                cache_name = args[1];
+            }
+            // --fuzzy <max edits>
+            else if (option == "--fuzzy")
+            {
+                fuzzy_distance = std::stoul(args[1]);
+            }
+            // --count <ships>
+            else if (option == "--count")
+            {
+                ship_count = std::stoul(args[1]);
+            }
+            // --rng <xoshiro256**|pcg64|mt19937|philox>
+            else if (option == "--rng")
+            {
+                rng_name = args[1];
+            }
+            // --seed <number>
+            else if (option == "--seed")
+            {
+                seed = std::stoull(args[1]);
+            }
+            // --first <ship number>
+            else if (option == "--first")
+            {
+                first_ship = std::stoull(args[1]);
+            }
+            // --threads <workers>, 0 for every core
+            else if (option == "--threads")
+            {
+                thread_count = std::stoul(args[1]);
+
+                if (thread_count == 0)
+                {
+                    thread_count = std::min<std::size_t>(max_fleet_threads,
+                        std::max(1U, std::thread::hardware_concurrency()));
+                }
+            }
+            else
+            {
+                throw std::runtime_error(
+                    "unknown option '" + std::string(option) + "'");
+            }
+
+            args = args.subspan(2);
+        }
+
+        // Applies to whichever taxonomy was picked
+        if (normalize)
+        {
+            Taxonomy::Activate(Taxonomy::Active().Normalized());
+        }
+
+        if (fuzzy_distance != 0)
+        {
+            Taxonomy::Activate(Taxonomy::Active().Fuzzy(fuzzy_distance));
+        }
+
+        // Opened once the taxonomy is settled, entries from another one
+        // are not reused
+        if (cache_name)
+        {
+            ClassificationCache::Activate(*cache_name);
+        }
+
+        // Only mentioned when a catalog has any, clean catalogs print as
+        // they always did
+        const auto report_ambiguous = [](const std::size_t count) {
+            if (count != 0)
+            {
+                std::cout << "Ambiguous lines settled by priority: " << count
+                          << '\n';
+            }
+        };
+
+        // Everything random in a run follows from one number, so --seed
+        // repeats a run exactly
+        std::uint64_t seeds = 0;
+
+        if (seed)
+        {
+            seeds = *seed;
+        }
+        else
+        {
+            std::random_device rd;
+            seeds = std::uint64_t{ rd() } << 32U | rd();
+        }
+
+        if (thread_count > max_fleet_threads)
+        {
+            throw std::runtime_error("--threads takes at most "
+                + std::to_string(max_fleet_threads) + " workers");
+        }
+
+        // A single thread writes its ships in order anyway
+        if (fleet_order == Fleet_Order::Unordered && thread_count == 1)
+        {
+            throw std::runtime_error("--unordered needs --threads");
+        }
+
+        // Parallel fleets need every ship to stand on its own, so they
+        // default to the counter-based engine
+        if (!rng_name)
+        {
+            rng_name = thread_count == 1 ? "xoshiro256**" : "philox";
+        }
+
+        auto ship_rng =
+            make_ship_rng(*rng_name, splitmix64(seeds), first_ship);
+
+        if (thread_count != 1 && !std::holds_alternative<Philox4x32>(ship_rng))
+        {
+            throw std::runtime_error(
+                "--threads needs a counter-based generator (philox)");
+        }
+
+        const auto stream_seed = splitmix64(seeds);
+
+        // One ship as always, or a --count fleet built through one reused
+        // ship and written out a block at a time, or by --threads workers
+        const auto print_ships = [ship_count, thread_count, fleet_order,
+                                     &ship_rng](
+                                     const IndexedPartSource auto& source) {
+            std::visit(
+                [&]<typename Rng>(Rng& rng) {
+                    if (ship_count == 1)
+                    {
+                        generate_fleet(source, 1, rng,
+                            [](const Spaceship& ship) { ship.Print(); });
+                        return;
+                    }
+
+                    if constexpr (CounterBasedRng<Rng>)
+                    {
+                        if (thread_count != 1)
+                        {
+                            generate_fleet_parallel(source, ship_count, rng,
+                                thread_count, fleet_order,
+                                [](const std::string_view text) {
+                                    std::cout << text;
+                                });
+                            return;
+                        }
+                    }
+
+                    constexpr std::size_t block_size = 1U << 20U;
+
+                    std::string text;
+                    text.reserve(block_size * 2);
+
+                    generate_fleet(source, ship_count, rng,
+                        [&text](const Spaceship& ship) {
+                            ship.Render(text);
+
+                            if (text.size() >= block_size)
+                            {
+                                std::cout << text;
+                                text.clear();
+                            }
+                        });
+
+                    std::cout << text;
+                },
+                ship_rng);
+        };
+
+        // Brings the cache up to date with a loaded catalog, silent without
+        // --cache
+        const auto update_cache = [](const Catalog& catalog) {
+            const auto* const cache = ClassificationCache::Active();
+
+            if (cache == nullptr)
+            {
+                return;
+            }
+
+            const auto misses = cache->MissCount();
+            const auto entries = cache->Update(catalog.Lines());
+
+            std::cout << "Classification cache: " << misses << " misses";
+
+            if (entries != 0)
+            {
+                std::cout << ", " << entries << " entries written";
+            }
+
+            std::cout << '\n';
+        };
+
+        // parts_list parsing is lambda
+        // taking advantage of C++20 templated lambdas and concepts
+        const auto fetch_parts_list =
+            [&report_ambiguous, &update_cache]<PathType T>(T&& fname) {
+                // Single mmap'd scan instead of counting and re-reading the
+                // file
+                auto catalog = Catalog::Load(std::forward<T>(fname));
+
+                std::cout << "Parts loaded from: " << fname << '\n';
+                report_ambiguous(catalog.AmbiguousCount());
+                update_cache(catalog);
+                return catalog;
+            };
+
+        // bench [MiB]
+        if (!args.empty() && std::string_view(args[0]) == "bench")
+        {
+            run_benchmarks(args.size() > 1 ? std::stoul(args[1]) : 256);
+            return 0;
+        }
+
+        // watch <parts.txt> [interval ms]
+        if (!args.empty() && std::string_view(args[0]) == "watch")
+        {
+            if (args.size() < 2)
+            {
+                throw std::runtime_error(
+                    "usage: watch <parts file> [interval ms]");
+            }
+
+            const CatalogWatcher watcher(args[1]);
+            const std::chrono::milliseconds interval(
+                args.size() > 2 ? std::stoul(args[2]) : 1000);
+
+            std::cout << "Watching parts from: " << args[1] << '\n';
+
+            // Each ship is built from whatever snapshot is current, reloads
+            // happen on the watcher thread
+            while (true)
+            {
+                const auto snapshot = watcher.Current();
+                print_ships(snapshot->parts);
+                std::cout.flush();
+                std::this_thread::sleep_for(interval);
+            }
+        }
+
+        // compile-catalog <parts.txt> <catalog.bin>
+        if (!args.empty() && std::string_view(args[0]) == "compile-catalog")
+        {
+            if (args.size() != 3)
+            {
+                throw std::runtime_error("usage: compile-catalog <parts file> "
+                                         "<output file>");
+            }
+
+            const auto catalog = fetch_parts_list(args[1]);
+            const auto part_count = CompiledCatalog::Compile(catalog, args[2]);
+
+            std::cout << "Compiled " << part_count << " parts into: " << args[2]
+                      << '\n';
+            return 0;
+        }
+
+        // Ternary for short-circuiting
+        const auto parts_filename =
+            !args.empty() ? args[0] : "vehicle_parts.txt";
+
+        // Several catalogs (or directories of them) are read concurrently
+        // and merged
+        if (args.size() > 1 || std::filesystem::is_directory(parts_filename))
+        {
+            const auto fnames = expand_catalog_paths(args);
+            const auto catalog = Catalog::LoadMany(fnames);
+
+            std::cout << "Parts loaded from: " << fnames.size() << " files ("
+                      << catalog.DuplicateCount() << " duplicates dropped)\n";
+            report_ambiguous(catalog.AmbiguousCount());
+            update_cache(catalog);
+
+            print_ships(catalog.Parts());
+            return 0;
+        }
+
+        // Streams are sampled as they arrive and never held in memory
+        if (PartStream::IsStream(parts_filename))
+        {
+            // The reservoirs hold one ship's worth of parts, every further
+            // ship would be drawn from that same sample
+            if (ship_count != 1)
+            {
+                throw std::runtime_error("--count needs a catalog file, "
+                                         "a stream only samples one ship");
+            }
+
+            const auto stream = PartStream::Drain(parts_filename, stream_seed);
+
+            std::cout << "Parts streamed from: " << parts_filename << " ("
+                      << stream.LineCount() << " lines)\n";
+            report_ambiguous(stream.AmbiguousCount());
+
+            print_ships(stream);
+            return 0;
+        }
+
+        // Compiled catalogs are usable as soon as they are mapped
+        if (CompiledCatalog::IsCompiled(parts_filename))
+        {
+            const auto compiled = CompiledCatalog::Load(parts_filename);
+
+            std::cout << "Parts loaded from: " << parts_filename
+                      << " (compiled)\n";
+
+            print_ships(compiled);
+            return 0;
+        }
+
+        // The catalog owns the bytes every part view points into
+        const auto catalog = fetch_parts_list(parts_filename);
 
-        // Only printing once so use r-value
-        Spaceship{ fetch_parts_list(parts_filename) }.Print();
+        // The catalog arrives classified and numbered
+        print_ships(catalog.Parts());
         return 0;
     }
     catch (const std::exception& ex)